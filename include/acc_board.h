@@ -5,6 +5,7 @@
 #define ACC_BOARD_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "acc_types.h"
@@ -17,6 +18,24 @@ extern "C" {
 typedef void (*acc_board_isr_t)(acc_sensor_t);
 
 
+/**
+ * @brief Handle of a sensor transfer prepared with acc_board_prepare_sensor_transfer()
+ */
+typedef struct acc_board_sensor_transfer_s *acc_board_sensor_transfer_t;
+
+
+/**
+ * @brief Phases of a sensor transfer
+ */
+typedef enum {
+	ACC_BOARD_TRANSFER_PHASE_LOCK,		/**< Reserving the SPI bus */
+	ACC_BOARD_TRANSFER_PHASE_CHIP_SELECT,	/**< Selecting the sensor */
+	ACC_BOARD_TRANSFER_PHASE_SPI,		/**< The SPI transfer */
+	ACC_BOARD_TRANSFER_PHASE_DESELECT,	/**< Deselecting the sensor and releasing the SPI bus */
+	ACC_BOARD_TRANSFER_PHASE_COUNT
+} acc_board_transfer_phase_t;
+
+
 /**
  * @brief Default SPI speed
  */
@@ -66,6 +85,29 @@ extern acc_status_t acc_board_start_sensor(acc_sensor_t sensor);
 extern acc_status_t acc_board_stop_sensor(acc_sensor_t sensor);
 
 
+/**
+ * @brief Power cycle a single sensor
+ *
+ * Toggles the ENABLE line of the specified sensor only. The board power and all other sensors
+ * are left untouched, so other sensors can keep communicating during the reset.
+ * A started sensor remains started and must be reconfigured before it is used again.
+ * Nothing is done for a sensor that is not started, it is already powered down.
+ *
+ * @param[in] sensor The sensor to be reset
+ * @return Status
+ */
+extern acc_status_t acc_board_reset_sensor(acc_sensor_t sensor);
+
+
+/**
+ * @brief Check if a sensor is started
+ *
+ * @param[in] sensor The sensor to check
+ * @return True if the sensor is started and not being stopped
+ */
+extern bool acc_board_is_sensor_started(acc_sensor_t sensor);
+
+
 /**
  * @brief Retrieve SPI bus and CS numbers for a specific sensor
  *
@@ -88,6 +130,47 @@ extern void acc_board_get_spi_bus_cs(acc_sensor_t sensor, uint_fast8_t *bus, uin
 extern acc_status_t acc_board_chip_select(acc_sensor_t sensor, uint_fast8_t cs_assert);
 
 
+/**
+ * @brief Prepare transfers to a started sensor
+ *
+ * SPI bus, chip select, speed and the underlying device handles are resolved once, so that
+ * acc_board_sensor_transfer() needs no further lookups. The handle is valid until the sensor is stopped.
+ *
+ * @param[in] sensor The sensor to prepare transfers for
+ * @return The prepared transfer, or NULL if prepared transfers are not supported
+ */
+extern acc_board_sensor_transfer_t acc_board_prepare_sensor_transfer(acc_sensor_t sensor);
+
+
+/**
+ * @brief Transfer data to a sensor using a prepared transfer
+ *
+ * Reserves the SPI bus, selects the sensor, transfers the data and deselects the sensor.
+ * When batching is enabled the sensor is left selected, see acc_board_set_sensor_transfer_batching().
+ *
+ * @param[in] transfer The prepared transfer
+ * @param[in,out] buffer The data to be transferred, the received data is returned in the same buffer
+ * @param[in] buffer_size The size of the buffer in bytes
+ * @param[out] phase_end_ns The CLOCK_MONOTONIC time [ns] at which each acc_board_transfer_phase_t ended is returned here, or NULL
+ * @return Status
+ */
+extern acc_status_t acc_board_sensor_transfer(acc_board_sensor_transfer_t transfer, uint8_t *buffer, size_t buffer_size,
+                                              uint64_t *phase_end_ns);
+
+
+/**
+ * @brief Enable or disable batching of consecutive transfers to a sensor
+ *
+ * While batching, the sensor stays selected between transfers and is only deselected when another sensor
+ * on the same bus is selected, so consecutive transfers to the sensor need a single SPI transfer each.
+ * The sensor is deselected when batching is disabled.
+ *
+ * @param[in] transfer The prepared transfer
+ * @param[in] batching True to enable batching
+ */
+extern void acc_board_set_sensor_transfer_batching(acc_board_sensor_transfer_t transfer, bool batching);
+
+
 /**
  * @brief Get information if the sensor interrupt pin is connected for the specified sensor
  *
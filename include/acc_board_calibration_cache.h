@@ -0,0 +1,77 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#ifndef ACC_BOARD_CALIBRATION_CACHE_H_
+#define ACC_BOARD_CALIBRATION_CACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "acc_board_temperature.h"
+#include "acc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Temperature value to use when the temperature of the board is not known
+ *
+ * A calibration stored with an unknown temperature only matches an unknown temperature.
+ */
+#define ACC_BOARD_CALIBRATION_CACHE_TEMPERATURE_UNKNOWN		ACC_BOARD_TEMPERATURE_UNKNOWN
+
+/**
+ * @brief Maximum temperature difference [°C] for a stored calibration to be reused
+ */
+#define ACC_BOARD_CALIBRATION_CACHE_TEMPERATURE_TOLERANCE	5
+
+
+/**
+ * @brief Open the calibration cache
+ *
+ * The cache is a small memory-mapped file, it is created if it does not exist.
+ *
+ * @param[in] path Path to the cache file
+ * @return Status
+ */
+extern acc_status_t acc_board_calibration_cache_open(const char *path);
+
+
+/**
+ * @brief Close the calibration cache
+ */
+extern void acc_board_calibration_cache_close(void);
+
+
+/**
+ * @brief Feed a stored calibration back to RSS
+ *
+ * Looks for a calibration of the sensor made on this board, at the current reference frequency and
+ * at a temperature close to the given one. Must be called before the service is activated.
+ *
+ * @param[in] sensor The sensor to restore calibration for
+ * @param[in] temperature Current board temperature [°C], or ACC_BOARD_CALIBRATION_CACHE_TEMPERATURE_UNKNOWN
+ * @return True if a stored calibration was handed to RSS
+ */
+extern bool acc_board_calibration_cache_restore(acc_sensor_t sensor, int_fast16_t temperature);
+
+
+/**
+ * @brief Store the current calibration of a sensor
+ *
+ * Must be called after a service has been activated on the sensor.
+ *
+ * @param[in] sensor The sensor to store calibration for
+ * @param[in] temperature Current board temperature [°C], or ACC_BOARD_CALIBRATION_CACHE_TEMPERATURE_UNKNOWN
+ * @return True if the calibration was stored
+ */
+extern bool acc_board_calibration_cache_store(acc_sensor_t sensor, int_fast16_t temperature);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
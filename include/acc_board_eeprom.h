@@ -0,0 +1,90 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#ifndef ACC_BOARD_EEPROM_H_
+#define ACC_BOARD_EEPROM_H_
+
+#include <stdint.h>
+
+#include "acc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Maximum number of sensors described by the board EEPROM
+ */
+#define ACC_BOARD_EEPROM_SENSOR_COUNT_MAX	4
+
+/**
+ * @brief Size in bytes of the per-sensor calibration data stored in the board EEPROM
+ */
+#define ACC_BOARD_EEPROM_CALIBRATION_SIZE	64
+
+
+/**
+ * @brief Board identity and calibration data stored in the board EEPROM
+ */
+typedef struct {
+	uint32_t	board_serial;
+	uint16_t	board_id;
+	uint16_t	board_revision;
+	uint32_t	ref_freq;	/**< Nominal reference frequency [Hz], 0 if not programmed */
+	int32_t		ref_freq_trim_ppb[ACC_BOARD_EEPROM_SENSOR_COUNT_MAX];	/**< Reference frequency error seen by each sensor [ppb] */
+	uint8_t		calibration[ACC_BOARD_EEPROM_SENSOR_COUNT_MAX][ACC_BOARD_EEPROM_CALIBRATION_SIZE];
+} acc_board_eeprom_t;
+
+
+/**
+ * @brief Set the directory where the EEPROM contents are cached
+ *
+ * The cache file is named after the board serial number. Passing NULL disables the file cache.
+ * Must be called before the first call to acc_board_eeprom_read() to have any effect.
+ *
+ * @param[in] path Directory for the cache files
+ */
+extern void acc_board_eeprom_set_cache_dir(const char *path);
+
+
+/**
+ * @brief Start reading the board EEPROM without waiting for it
+ *
+ * The read is queued to the I2C worker thread, so that a later acc_board_eeprom_read() finds the
+ * data in memory. Nothing is done if the result of a read is already known or being read.
+ */
+extern void acc_board_eeprom_prefetch(void);
+
+
+/**
+ * @brief Read board identity and calibration data
+ *
+ * The first call reads the EEPROM header over I2C and then either loads the full image from the
+ * cache file of the board, or reads it from the EEPROM in one sequential transfer and updates the
+ * cache file. The transfers are queued to the I2C worker thread, and the call waits for them.
+ * Subsequent calls return the data kept in memory, or the status of the failed read, until
+ * acc_board_eeprom_invalidate() is called.
+ *
+ * Must not be called from an I2C completion callback.
+ *
+ * @param[out] eeprom The board EEPROM contents are returned here
+ * @return Status
+ */
+extern acc_status_t acc_board_eeprom_read(acc_board_eeprom_t *eeprom);
+
+
+/**
+ * @brief Forget the EEPROM contents kept in memory
+ *
+ * The next call to acc_board_eeprom_read() will check the EEPROM header again. A read in progress
+ * is read again once it is done, and the threads waiting for it get the result of the new read.
+ */
+extern void acc_board_eeprom_invalidate(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#ifndef ACC_BOARD_TEMPERATURE_H_
+#define ACC_BOARD_TEMPERATURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "acc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Temperature value returned when the temperature of the board is not known
+ */
+#define ACC_BOARD_TEMPERATURE_UNKNOWN		INT16_MIN
+
+/**
+ * @brief Default temperature drift [°C] since calibration that makes a sensor need recalibration
+ */
+#define ACC_BOARD_TEMPERATURE_DRIFT_THRESHOLD	10
+
+
+/**
+ * @brief Start monitoring the board temperature
+ *
+ * The temperature is read from an LM75 compatible sensor on I2C, or from the SoC thermal zone if
+ * there is no such sensor. A first reading is made before the function returns, after that the
+ * temperature is read by a background thread. The thread has normal scheduling, it does not get
+ * the attributes set by acc_driver_os_linux_set_thread_attributes() for the radar threads.
+ *
+ * @param[in] period_ms Time between readings
+ * @param[in] drift_threshold Temperature drift [°C] since calibration that makes a sensor need recalibration
+ * @return Status, failure if no temperature source is available
+ */
+extern acc_status_t acc_board_temperature_monitor_start(uint_fast16_t period_ms, uint_fast8_t drift_threshold);
+
+
+/**
+ * @brief Stop monitoring the board temperature
+ *
+ * The last reading is kept.
+ */
+extern void acc_board_temperature_monitor_stop(void);
+
+
+/**
+ * @brief Get the latest board temperature
+ *
+ * Does not block and does not access the bus, it can be called from the sweep loop.
+ *
+ * @return Board temperature [°C], or ACC_BOARD_TEMPERATURE_UNKNOWN
+ */
+extern int_fast16_t acc_board_temperature_get(void);
+
+
+/**
+ * @brief Tell the monitor that a sensor has been calibrated
+ *
+ * The drift of the sensor is measured from the given temperature. Passing
+ * ACC_BOARD_TEMPERATURE_UNKNOWN stops drift detection for the sensor.
+ *
+ * @param[in] sensor The sensor
+ * @param[in] temperature Board temperature [°C] of the calibration
+ */
+extern void acc_board_temperature_set_calibrated(acc_sensor_t sensor, int_fast16_t temperature);
+
+
+/**
+ * @brief Check if the temperature has drifted too far since a sensor was calibrated
+ *
+ * Does not block and does not access the bus, it can be called from the sweep loop.
+ * Cleared by acc_board_temperature_set_calibrated().
+ *
+ * @param[in] sensor The sensor
+ * @return True if the sensor should be recalibrated
+ */
+extern bool acc_board_temperature_recalibration_needed(acc_sensor_t sensor);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
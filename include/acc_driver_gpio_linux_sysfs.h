@@ -18,6 +18,18 @@ extern "C" {
  */
 extern void acc_driver_gpio_linux_sysfs_register(uint_fast16_t pin_count);
 
+
+/**
+ * @brief Get the file descriptor of the value file of an output pin
+ *
+ * Writing "0" or "1" to the file descriptor sets the level of the pin without passing through the driver.
+ * The driver is not aware of such writes, so the pin must be left at the level the driver last wrote.
+ *
+ * @param pin GPIO pin
+ * @return The file descriptor, or -1 if the pin is not an open output
+ */
+extern int acc_driver_gpio_linux_sysfs_get_output_fd(uint_fast8_t pin);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,10 @@
 #ifndef ACC_DRIVER_HAL_H_
 #define ACC_DRIVER_HAL_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "acc_board.h"
 #include "acc_definitions.h"
 
 
@@ -12,6 +16,18 @@ extern "C" {
 #endif
 
 
+/**
+ * @brief Accumulated timing of one phase of the transfers to a sensor
+ */
+typedef struct {
+	uint32_t	count;		/**< Number of timed transfers */
+	uint64_t	sum_ns;		/**< Total time [ns] */
+	uint32_t	min_ns;		/**< Shortest time [ns] */
+	uint32_t	max_ns;		/**< Longest time [ns] */
+	uint32_t	p99_ns;		/**< 99th percentile [ns], within 25% */
+} acc_driver_hal_transfer_timing_t;
+
+
 /**
  * @brief Initialize hal driver
  *
@@ -26,6 +42,116 @@ extern bool acc_driver_hal_init(void);
 extern acc_hal_t acc_driver_hal_get_implementation(void);
 
 
+/**
+ * @brief Enable or disable batching of consecutive transfers to a sensor
+ *
+ * With batching enabled the sensor is kept selected between transfers, which reduces each
+ * transfer to a single SPI transfer. Useful while a service is created and activated, when
+ * RSS configures and calibrates the sensor with many small transfers. The setting is kept
+ * when the sensor is powered off and on again.
+ *
+ * @param[in] sensor_id The sensor
+ * @param[in] batching True to enable batching
+ */
+extern void acc_driver_hal_set_transfer_batching(acc_sensor_id_t sensor_id, bool batching);
+
+
+/**
+ * @brief Enable or disable prepared transfers
+ *
+ * Prepared transfers are enabled by default. When disabled, transfers go through the generic
+ * board and device functions, which is mainly useful to compare the two. The setting takes effect
+ * the next time a sensor is powered on.
+ *
+ * @param[in] enable True to enable prepared transfers
+ */
+extern void acc_driver_hal_set_prepared_transfers(bool enable);
+
+
+/**
+ * @brief Enable or disable timing of each phase of the transfers to the sensors
+ *
+ * Timing is disabled by default. Accumulated timing is kept when timing is disabled.
+ *
+ * @param[in] enable True to enable timing
+ */
+extern void acc_driver_hal_set_transfer_timing(bool enable);
+
+
+/**
+ * @brief Get the accumulated timing of one phase of the transfers to a sensor
+ *
+ * The timing may be updated by other threads while it is read, so the values are not
+ * guaranteed to be taken at exactly the same time.
+ *
+ * @param[in] sensor_id The sensor
+ * @param[in] phase The transfer phase
+ * @param[out] timing The accumulated timing is returned here
+ * @return True if timing is available for the sensor
+ */
+extern bool acc_driver_hal_get_transfer_timing(acc_sensor_id_t sensor_id, acc_board_transfer_phase_t phase,
+                                               acc_driver_hal_transfer_timing_t *timing);
+
+
+/**
+ * @brief Clear the accumulated timing of all sensors
+ */
+extern void acc_driver_hal_reset_transfer_timing(void);
+
+
+/**
+ * @brief Check if a fault has been detected on a sensor
+ *
+ * A fault is flagged when a transfer to the sensor fails, when its interrupt has been active
+ * without a transfer for longer than the interrupt timeout, or when reported with
+ * acc_driver_hal_report_sensor_fault(). The interrupt is checked by this function, so it should
+ * be called regularly, for instance once per sweep. The flag is cleared by
+ * acc_driver_hal_recover_sensor().
+ *
+ * @param[in] sensor_id The sensor to check
+ * @return True if the sensor has a fault
+ */
+extern bool acc_driver_hal_sensor_has_fault(acc_sensor_id_t sensor_id);
+
+
+/**
+ * @brief Set how long an interrupt may stay active without a transfer before the sensor is faulty
+ *
+ * Must be longer than the time between two sweeps that the application reads, or a sensor that
+ * works is reported as faulty. The interrupts are not checked by default.
+ *
+ * @param[in] timeout_ms The timeout [ms], 0 to not check the interrupts
+ */
+extern void acc_driver_hal_set_interrupt_timeout(uint32_t timeout_ms);
+
+
+/**
+ * @brief Report a fault detected by the application on a sensor
+ *
+ * Typically used when a service on the sensor times out waiting for data.
+ *
+ * @param[in] sensor_id The faulty sensor
+ */
+extern void acc_driver_hal_report_sensor_fault(acc_sensor_id_t sensor_id);
+
+
+/**
+ * @brief Recover a faulty sensor without resetting the board
+ *
+ * The sensor is power cycled through its ENABLE line and its calibration is reset, while
+ * services on the other sensors keep running. A sensor that has been stopped by its service is
+ * started for the power cycle and stopped again. To recover a sensor:
+ *
+ * 1. Deactivate the service of the faulty sensor
+ * 2. Call this function
+ * 3. Activate the service again, the sensor is calibrated on activation
+ *
+ * @param[in] sensor_id The sensor to recover
+ * @return True if the sensor was recovered
+ */
+extern bool acc_driver_hal_recover_sensor(acc_sensor_id_t sensor_id);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,77 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#ifndef ACC_DRIVER_HAL_RECORD_H_
+#define ACC_DRIVER_HAL_RECORD_H_
+
+#include <stdbool.h>
+
+#include "acc_definitions.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Replay speed
+ */
+typedef enum {
+	ACC_DRIVER_HAL_REPLAY_FULL_SPEED,	/**< Serve the recording as fast as RSS asks for it */
+	ACC_DRIVER_HAL_REPLAY_REAL_TIME		/**< Keep the timing between sensor accesses of the recording */
+} acc_driver_hal_replay_speed_t;
+
+
+/**
+ * @brief Start recording all sensor accesses made through a HAL
+ *
+ * The functions of the HAL are replaced with functions that call the original functions and log
+ * the results, and the time since the previous access, to a binary file. Transfers are logged
+ * with both the transmitted and the received data. The recorded HAL reports
+ * interrupt service routines as unsupported so that RSS polls the interrupt, which makes the
+ * recording replayable. Only one recording can be active at a time.
+ *
+ * @param[in,out] hal The HAL to record, typically from acc_driver_hal_get_implementation()
+ * @param[in] path The file to record to
+ * @return True if recording was started
+ */
+extern bool acc_driver_hal_record_start(acc_hal_t *hal, const char *path);
+
+
+/**
+ * @brief Stop recording and close the file
+ *
+ * Must not be called before RSS has been deactivated.
+ */
+extern void acc_driver_hal_record_stop(void);
+
+
+/**
+ * @brief Create a HAL that replays a recording
+ *
+ * The returned HAL needs no hardware. Every sensor access returns the recorded result, in the
+ * recorded order. An access that does not match the recording fails, this includes a transfer
+ * that transmits other data than was recorded.
+ *
+ * @param[in] path The recording
+ * @param[in] speed The replay speed
+ * @param[out] hal The replaying HAL is returned here, to be passed to acc_rss_activate_with_hal()
+ * @return True if the recording could be loaded
+ */
+extern bool acc_driver_hal_replay_open(const char *path, acc_driver_hal_replay_speed_t speed, acc_hal_t *hal);
+
+
+/**
+ * @brief Release a recording loaded with acc_driver_hal_replay_open()
+ *
+ * Must not be called before RSS has been deactivated.
+ */
+extern void acc_driver_hal_replay_close(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
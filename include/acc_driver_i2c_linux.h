@@ -4,16 +4,103 @@
 #ifndef ACC_DRIVER_I2C_LINUX_H_
 #define ACC_DRIVER_I2C_LINUX_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "acc_types.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
+/**
+ * @brief Completion callback of an asynchronous transfer
+ *
+ * Called from the I2C worker thread.
+ *
+ * @param[in] status Status of the transfer
+ * @param[in] user_data The user data given when the transfer was queued
+ */
+typedef void (*acc_driver_i2c_linux_callback_t)(acc_status_t status, void *user_data);
+
+
 /**
  * @brief Request driver to register with appropriate device(s)
  */
 extern void acc_driver_i2c_linux_register(void);
 
+
+/**
+ * @brief Assign a device to an I2C adapter
+ *
+ * Transfers to the device are made on /dev/i2c-<adapter>. Devices that are not assigned to any
+ * adapter are on adapter 1. Each adapter is opened by the first transfer on it and has its own lock,
+ * so transfers on different adapters do not wait for each other.
+ *
+ * @param[in] device_id The 7-bit ID of the device
+ * @param[in] adapter The number of the adapter, 0 to 7
+ * @return Status
+ */
+extern acc_status_t acc_driver_i2c_linux_set_adapter(uint8_t device_id, uint_fast8_t adapter);
+
+
+/**
+ * @brief Queue an I2C read
+ *
+ * The read is made by the I2C worker thread, in the order the transfers were queued, and the
+ * callback is called when it is done. The calling thread never waits for the bus. The buffer
+ * must stay valid until the callback has been called.
+ *
+ * @param[in] device_id The ID of the device to read from
+ * @param[in] address The address to start reading from
+ * @param[in] address_size Number of bytes of address, 1 or 2, or 0 to read from the last read/written address
+ * @param[out] buffer The result of the read is stored here
+ * @param[in] buffer_size The size of the buffer
+ * @param[in] callback Called when the read is done, may be NULL
+ * @param[in] user_data Passed to the callback
+ * @return Status, ACC_STATUS_OUT_OF_MEMORY if the queue is full
+ */
+extern acc_status_t acc_driver_i2c_linux_read_async(uint8_t device_id, uint16_t address, uint_fast8_t address_size, uint8_t *buffer, size_t buffer_size,
+                                                    acc_driver_i2c_linux_callback_t callback, void *user_data);
+
+
+/**
+ * @brief Queue an I2C write
+ *
+ * Like acc_driver_i2c_linux_read_async(). The buffer must stay valid until the callback has been called.
+ *
+ * @param[in] device_id The ID of the device to write to
+ * @param[in] address The address to write to
+ * @param[in] address_size Number of bytes of address, 1 or 2
+ * @param[in] buffer The data to be written
+ * @param[in] buffer_size The size of the buffer
+ * @param[in] callback Called when the write is done, may be NULL
+ * @param[in] user_data Passed to the callback
+ * @return Status, ACC_STATUS_OUT_OF_MEMORY if the queue is full
+ */
+extern acc_status_t acc_driver_i2c_linux_write_async(uint8_t device_id, uint16_t address, uint_fast8_t address_size, const uint8_t *buffer, size_t buffer_size,
+                                                     acc_driver_i2c_linux_callback_t callback, void *user_data);
+
+
+/**
+ * @brief Wait until all queued transfers are done and their callbacks have returned
+ *
+ * Must not be called from a callback.
+ */
+extern void acc_driver_i2c_linux_drain(void);
+
+
+/**
+ * @brief Run the queued transfers and stop the I2C worker thread
+ *
+ * The worker is created by the first transfer that is queued, with normal scheduling and not the
+ * attributes set by acc_driver_os_linux_set_thread_attributes(), and is started again by the first
+ * transfer queued after the stop. A transfer queued by another thread during the stop waits for the
+ * stop to finish. Must not be called from a callback.
+ */
+extern void acc_driver_i2c_linux_stop(void);
+
 #ifdef __cplusplus
 }
 #endif
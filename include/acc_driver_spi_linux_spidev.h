@@ -4,6 +4,11 @@
 #ifndef ACC_DRIVER_SPI_LINUX_SPIDEV_H_
 #define ACC_DRIVER_SPI_LINUX_SPiDEV_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "acc_types.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -14,6 +19,31 @@ extern "C" {
  */
 extern void acc_driver_spi_linux_spidev_register(void);
 
+
+/**
+ * @brief Get the file descriptor of an SPI device, the device is opened if needed
+ *
+ * Intended for boards that resolve a transfer once and then call
+ * acc_driver_spi_linux_spidev_transfer_fd() directly.
+ *
+ * @param bus SPI bus
+ * @param device SPI device on bus
+ * @return The file descriptor, or -1 if the device could not be opened
+ */
+extern int acc_driver_spi_linux_spidev_get_fd(uint_fast8_t bus, uint_fast8_t device);
+
+
+/**
+ * @brief Data transfer (SPI) on a file descriptor from acc_driver_spi_linux_spidev_get_fd()
+ *
+ * @param fd The file descriptor of the SPI device
+ * @param speed SPI transfer speed in bps
+ * @param buffer The data to be transferred
+ * @param buffer_size The size of the buffer in bytes
+ * @return Status
+ */
+extern acc_status_t acc_driver_spi_linux_spidev_transfer_fd(int fd, uint32_t speed, uint8_t *buffer, size_t buffer_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,17 +4,674 @@
 #ifndef ACC_OS_LINUX_H_
 #define ACC_OS_LINUX_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "acc_os.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
+/**
+ * @brief Number of size classes of the pool allocator
+ */
+#define ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT	8
+
+
+/**
+ * @brief Number of call sites tracked by the heap accounting, a power of two
+ */
+#define ACC_DRIVER_OS_LINUX_MEM_SITE_COUNT_MAX	128
+
+
+/**
+ * @brief Allocator behind acc_os_mem_alloc() and acc_os_mem_free()
+ */
+typedef enum {
+	ACC_DRIVER_OS_LINUX_ALLOCATOR_MALLOC,	/**< malloc() and free() of the C library */
+	ACC_DRIVER_OS_LINUX_ALLOCATOR_POOL	/**< Size class pool with per-thread caches */
+} acc_driver_os_linux_allocator_t;
+
+
+/**
+ * @brief Statistics of one size class of the pool allocator
+ */
+typedef struct {
+	size_t		block_size;	/**< Largest allocation served by the size class */
+	uint32_t	allocations;
+	uint32_t	frees;
+	uint32_t	blocks;		/**< Number of blocks carved, free or in use */
+} acc_driver_os_linux_pool_class_stats_t;
+
+
+/**
+ * @brief Statistics of the pool allocator
+ */
+typedef struct {
+	acc_driver_os_linux_pool_class_stats_t	classes[ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT];
+	uint32_t				large_allocations;	/**< Allocations too large for the pool, passed on to malloc() */
+	uint32_t				large_frees;
+	size_t					slab_bytes;		/**< Memory taken from malloc() for the size classes */
+} acc_driver_os_linux_pool_stats_t;
+
+
+/**
+ * @brief Arena for scoped bump allocation
+ */
+typedef struct acc_driver_os_linux_arena_s *acc_driver_os_linux_arena_t;
+
+
+/**
+ * @brief Usage of an arena
+ */
+typedef struct {
+	size_t		capacity;
+	size_t		used;		/**< Bytes allocated in the current scope */
+	size_t		peak;		/**< Largest number of bytes allocated in any scope */
+	uint32_t	overflows;	/**< Allocations that did not fit and were passed on to the allocator */
+} acc_driver_os_linux_arena_stats_t;
+
+
+/**
+ * @brief Spin-then-futex mutex
+ *
+ * Needs no allocation and can be embedded in other structs. Initialize with
+ * ACC_DRIVER_OS_LINUX_FUTEX_MUTEX_INIT or acc_driver_os_linux_futex_mutex_init().
+ * Only valid within one process.
+ */
+typedef struct {
+	uint32_t	state;
+} acc_driver_os_linux_futex_mutex_t;
+
+#define ACC_DRIVER_OS_LINUX_FUTEX_MUTEX_INIT	{ 0 }
+
+
+/**
+ * @brief Attributes of a new thread
+ */
+typedef struct {
+	size_t		stack_size;	/**< Stack size [bytes], 0 for the default of the C library */
+	const char	*name;		/**< Thread name, at most 15 characters are used, NULL for no name */
+	int_fast8_t	priority;	/**< SCHED_FIFO priority 1 to 99, 0 for normal scheduling */
+	uint32_t	cpu_mask;	/**< Bit n allows the thread to run on CPU n, 0 for all CPUs */
+	bool		stack_tracking;	/**< Track the stack high-water mark, see acc_driver_os_linux_thread_get_stack_usage() */
+} acc_driver_os_linux_thread_attributes_t;
+
+#define ACC_DRIVER_OS_LINUX_THREAD_ATTRIBUTES_DEFAULT	{ 0, NULL, 0, 0, false }
+
+
+/**
+ * @brief A task run by the task pool
+ */
+typedef void (*acc_driver_os_linux_task_t)(void *param);
+
+
+/**
+ * @brief A set of tasks that can be waited for together
+ *
+ * Initialize with ACC_DRIVER_OS_LINUX_TASK_GROUP_INIT. Can be reused when all its tasks are done.
+ */
+typedef struct {
+	uint32_t	pending;
+} acc_driver_os_linux_task_group_t;
+
+#define ACC_DRIVER_OS_LINUX_TASK_GROUP_INIT	{ 0 }
+
+
+/**
+ * @brief Producers of a ring
+ */
+typedef enum {
+	ACC_DRIVER_OS_LINUX_RING_SPSC,	/**< One producer thread */
+	ACC_DRIVER_OS_LINUX_RING_MPSC	/**< Any number of producer threads */
+} acc_driver_os_linux_ring_type_t;
+
+
+/**
+ * @brief Lock-free ring of fixed size elements with one consumer
+ */
+typedef struct acc_driver_os_linux_ring_s *acc_driver_os_linux_ring_t;
+
+
+/**
+ * @brief Periodic timer
+ */
+typedef struct acc_driver_os_linux_timer_s *acc_driver_os_linux_timer_t;
+
+
+/**
+ * @brief Counting semaphore with timeouts on CLOCK_MONOTONIC
+ *
+ * The semaphore behind acc_os_semaphore_t. Initialize with acc_driver_os_linux_futex_semaphore_init().
+ * Only valid within one process.
+ */
+typedef struct {
+	uint32_t	count;
+	uint32_t	waiters;
+} acc_driver_os_linux_futex_semaphore_t;
+
+
+/**
+ * @brief Heap usage of all allocations
+ */
+typedef struct {
+	size_t		current_bytes;
+	size_t		peak_bytes;
+	uint32_t	allocations;
+	uint32_t	frees;
+	float		allocations_per_second;	/**< Since the previous call to acc_driver_os_linux_mem_get_stats() */
+} acc_driver_os_linux_mem_stats_t;
+
+
+/**
+ * @brief Heap usage of one call site
+ */
+typedef struct {
+	const void	*address;	/**< Return address of the allocation, NULL for call sites that did not fit in the table */
+	uint32_t	allocations;
+	uint32_t	frees;
+	size_t		current_bytes;
+	size_t		peak_bytes;
+} acc_driver_os_linux_mem_site_t;
+
+
 /**
  * @brief Request driver to register with appropriate device(s)
  */
 extern void acc_driver_os_linux_register(void);
 
 
+/**
+ * @brief Select the allocator to register
+ *
+ * Memory from one allocator must not be freed by another, so the allocator can only be selected
+ * before the driver is registered, normally before acc_board_init().
+ *
+ * @param[in] allocator The allocator
+ * @return True if the allocator was selected, false if the driver is already registered
+ */
+extern bool acc_driver_os_linux_set_allocator(acc_driver_os_linux_allocator_t allocator);
+
+
+/**
+ * @brief Select futex mutexes for acc_os_mutex_create()
+ *
+ * The mutexes of the OS driver are pthread mutexes by default. Must be called before the driver is
+ * registered, normally before acc_board_init().
+ *
+ * @param[in] enable True to use acc_driver_os_linux_futex_mutex_t behind acc_os_mutex_t
+ * @return True if the setting was changed, false if the driver is already registered
+ */
+extern bool acc_driver_os_linux_set_futex_mutex(bool enable);
+
+
+/**
+ * @brief Create a new thread with attributes
+ *
+ * If the real time priority is not permitted, the thread is created with normal scheduling and a
+ * warning is logged. The thread is cleaned up with acc_os_thread_cleanup().
+ *
+ * @param[in] func Function implementing the thread code
+ * @param[in] param Parameter to be passed to the thread function
+ * @param[in] attributes The thread attributes
+ * @return A handle to the new thread, NULL if the thread could not be created
+ */
+extern acc_os_thread_handle_t acc_driver_os_linux_thread_create_ex(void (*func)(void *param), void *param,
+                                                                   const acc_driver_os_linux_thread_attributes_t *attributes);
+
+
+/**
+ * @brief Set the attributes of threads created by acc_os_thread_create()
+ *
+ * Applies to the threads of RSS and of the drivers, which are all created after the call. The name
+ * is not copied and must remain valid.
+ *
+ * @param[in] attributes The thread attributes
+ */
+extern void acc_driver_os_linux_set_thread_attributes(const acc_driver_os_linux_thread_attributes_t *attributes);
+
+
+/**
+ * @brief Get the attributes of threads created by acc_os_thread_create()
+ *
+ * @param[out] attributes The thread attributes
+ */
+extern void acc_driver_os_linux_get_thread_attributes(acc_driver_os_linux_thread_attributes_t *attributes);
+
+
+/**
+ * @brief Get the stack high-water mark of a thread
+ *
+ * The thread must have been created with stack tracking. Its stack is then mapped by the driver and
+ * never touched before the thread runs, so the deepest page the thread has used is the lowest
+ * resident page of the mapping, and the usage is rounded up to whole pages. The pages are locked as
+ * they are used, where RLIMIT_MEMLOCK permits it; otherwise a swapped out page is not counted. Can be
+ * called from any thread while the thread is not cleaned up.
+ *
+ * @param[in] thread The thread
+ * @return The number of bytes of stack used so far, 0 if the stack of the thread is not tracked
+ */
+extern size_t acc_driver_os_linux_thread_get_stack_usage(acc_os_thread_handle_t thread);
+
+
+/**
+ * @brief Print the stack size and high-water mark of the threads created with stack tracking
+ *
+ * Threads that have been cleaned up are listed with the high-water mark they reached. A thread takes
+ * over the line of a cleaned up thread with the same name, so the line shows the peak of them all.
+ *
+ * @param[in] file The file to print to
+ */
+extern void acc_driver_os_linux_print_stack_report(FILE *file);
+
+
+/**
+ * @brief Run a task on the task pool
+ *
+ * The pool has one worker thread per CPU, started on first use with the attributes from
+ * acc_driver_os_linux_set_thread_attributes() and a 256 KiB stack. Each worker has its own queue, and
+ * idle workers take tasks from the queues of the others. A task submitted from a task goes to the
+ * queue of the worker running it. If the pool can not take the task, it is run by the caller before
+ * the call returns.
+ *
+ * @param[in,out] group The group to add the task to, NULL if the task will not be waited for
+ * @param[in] func The task
+ * @param[in] param Parameter to be passed to the task
+ */
+extern void acc_driver_os_linux_task_pool_submit(acc_driver_os_linux_task_group_t *group, acc_driver_os_linux_task_t func, void *param);
+
+
+/**
+ * @brief Wait until all tasks of a group are done
+ *
+ * The calling thread runs queued tasks while it waits. Can be called from a task.
+ *
+ * @param[in,out] group The group
+ */
+extern void acc_driver_os_linux_task_pool_wait(acc_driver_os_linux_task_group_t *group);
+
+
+/**
+ * @brief Get the number of worker threads of the task pool, starting the pool if needed
+ *
+ * @return The number of workers, 0 if no worker could be started
+ */
+extern uint_fast8_t acc_driver_os_linux_task_pool_get_worker_count(void);
+
+
+/**
+ * @brief Create a ring
+ *
+ * Elements are copied into and out of the ring, so the ring suits small structs and pointers to
+ * buffers. The indices of the producers and of the consumer are on separate cache lines.
+ *
+ * @param[in] type SPSC if all elements are pushed from one thread, MPSC otherwise
+ * @param[in] element_size Size of an element [bytes]
+ * @param[in] capacity Minimum number of elements the ring can hold, rounded up to a power of two
+ * @return The ring, NULL if it could not be created
+ */
+extern acc_driver_os_linux_ring_t acc_driver_os_linux_ring_create(acc_driver_os_linux_ring_type_t type, size_t element_size, uint32_t capacity);
+
+
+/**
+ * @brief Destroy a ring
+ *
+ * @param[in,out] ring The ring, set to NULL on return
+ */
+extern void acc_driver_os_linux_ring_destroy(acc_driver_os_linux_ring_t *ring);
+
+
+/**
+ * @brief Add an element to a ring
+ *
+ * Never blocks and takes no lock, so it can be called from callbacks of RSS. A system call is only
+ * made if the consumer waits for an element.
+ *
+ * @param[in] ring The ring
+ * @param[in] element The element to copy into the ring
+ * @return True if the element was added, false if the ring is full
+ */
+extern bool acc_driver_os_linux_ring_push(acc_driver_os_linux_ring_t ring, const void *element);
+
+
+/**
+ * @brief Take the oldest element from a ring
+ *
+ * Only one thread at a time may take elements from a ring.
+ *
+ * @param[in] ring The ring
+ * @param[out] element The element is copied here
+ * @param[in] timeout_us Maximum time to wait for an element [us], 0 to not wait
+ * @return True if an element was taken, false on timeout
+ */
+extern bool acc_driver_os_linux_ring_pop(acc_driver_os_linux_ring_t ring, void *element, uint32_t timeout_us);
+
+
+/**
+ * @brief Get the number of elements in a ring
+ *
+ * @param[in] ring The ring
+ * @return The number of elements, including elements that producers are adding
+ */
+extern uint32_t acc_driver_os_linux_ring_get_count(acc_driver_os_linux_ring_t ring);
+
+
+/**
+ * @brief Initialize a futex mutex
+ *
+ * @param[out] mutex The mutex
+ */
+extern void acc_driver_os_linux_futex_mutex_init(acc_driver_os_linux_futex_mutex_t *mutex);
+
+
+/**
+ * @brief Lock a futex mutex
+ *
+ * A contended mutex is retried for a short while before the thread sleeps in the kernel, since
+ * critical sections protected by these mutexes are expected to be very short. The mutex is not
+ * recursive.
+ *
+ * @param[in,out] mutex The mutex
+ */
+extern void acc_driver_os_linux_futex_mutex_lock(acc_driver_os_linux_futex_mutex_t *mutex);
+
+
+/**
+ * @brief Lock a futex mutex if it is not locked
+ *
+ * @param[in,out] mutex The mutex
+ * @return True if the mutex was locked by the call
+ */
+extern bool acc_driver_os_linux_futex_mutex_trylock(acc_driver_os_linux_futex_mutex_t *mutex);
+
+
+/**
+ * @brief Unlock a futex mutex
+ *
+ * A system call is only made if another thread waits for the mutex.
+ *
+ * @param[in,out] mutex The mutex
+ */
+extern void acc_driver_os_linux_futex_mutex_unlock(acc_driver_os_linux_futex_mutex_t *mutex);
+
+
+/**
+ * @brief Initialize a futex semaphore
+ *
+ * @param[out] semaphore The semaphore
+ * @param[in] count The initial count
+ */
+extern void acc_driver_os_linux_futex_semaphore_init(acc_driver_os_linux_futex_semaphore_t *semaphore, uint32_t count);
+
+
+/**
+ * @brief Wait for a futex semaphore to be signaled
+ *
+ * The deadline is taken from CLOCK_MONOTONIC, so it is not affected by changes of the wall clock.
+ *
+ * @param[in,out] semaphore The semaphore
+ * @param[in] timeout_us Maximum time to wait in microseconds, 0 to only check the count
+ * @return True if the count was decremented, false on timeout
+ */
+extern bool acc_driver_os_linux_futex_semaphore_wait(acc_driver_os_linux_futex_semaphore_t *semaphore, uint32_t timeout_us);
+
+
+/**
+ * @brief Signal a futex semaphore
+ *
+ * Can be called from a signal handler. A system call is only made if a thread waits for the semaphore.
+ *
+ * @param[in,out] semaphore The semaphore
+ */
+extern void acc_driver_os_linux_futex_semaphore_signal(acc_driver_os_linux_futex_semaphore_t *semaphore);
+
+
+/**
+ * @brief Wait for an OS semaphore with a timeout in microseconds
+ *
+ * Same as acc_os_semaphore_wait() with a finer timeout, for waits shorter than a millisecond or
+ * longer than the 16 bit millisecond range.
+ *
+ * @param[in] sem The semaphore
+ * @param[in] timeout_us Maximum time to wait in microseconds
+ * @return 0 if the semaphore was signaled, -1 on timeout or error
+ */
+extern int_fast8_t acc_driver_os_linux_semaphore_wait_us(acc_os_semaphore_t sem, uint32_t timeout_us);
+
+
+/**
+ * @brief Get a monotonic timestamp
+ *
+ * Reads the ARM generic timer directly where user space has access to it, and CLOCK_MONOTONIC_RAW
+ * through the vDSO otherwise. The time is not adjusted by NTP and has an unspecified epoch, so it is
+ * only meaningful compared to other timestamps from this function in the same process.
+ *
+ * @return Time [ns]
+ */
+extern uint64_t acc_driver_os_linux_time_ns(void);
+
+
+/**
+ * @brief Sleep until a point in time
+ *
+ * Unlike acc_os_sleep_us(), the time spent between sleeps does not add up when sleeping to deadlines
+ * that are advanced by a fixed interval.
+ *
+ * @param[in] deadline_ns The time to sleep until [ns], in the time base of acc_driver_os_linux_time_ns()
+ */
+extern void acc_driver_os_linux_sleep_until(uint64_t deadline_ns);
+
+
+/**
+ * @brief Create a periodic timer
+ *
+ * The timer starts when created and expires once every period on CLOCK_MONOTONIC, independently of
+ * how long the caller takes between waits.
+ *
+ * @param[in] period_us The period [us]
+ * @return The timer, NULL if it could not be created
+ */
+extern acc_driver_os_linux_timer_t acc_driver_os_linux_timer_create(uint32_t period_us);
+
+
+/**
+ * @brief Wait for the next expiration of a periodic timer
+ *
+ * Returns at once if the timer has expired since the previous wait.
+ *
+ * @param[in] timer The timer
+ * @return Number of expirations since the previous wait, more than 1 if the caller fell behind, 0 on error
+ */
+extern uint32_t acc_driver_os_linux_timer_wait(acc_driver_os_linux_timer_t timer);
+
+
+/**
+ * @brief Destroy a periodic timer
+ *
+ * @param[in,out] timer The timer, set to NULL on return
+ */
+extern void acc_driver_os_linux_timer_destroy(acc_driver_os_linux_timer_t *timer);
+
+
+/**
+ * @brief Enable heap accounting
+ *
+ * Every allocation through acc_os_mem_alloc() gets a small header recording its size and call site,
+ * and the current and peak bytes are counted per call site and in total. The call site is the return
+ * address seen by the OS driver, which is the caller of acc_os_mem_alloc() when the call reaches the
+ * driver as a tail call, and a location in acc_os_mem_alloc() otherwise.
+ *
+ * Memory allocated with accounting must be freed with accounting, so accounting can only be enabled
+ * before the driver is registered, normally before acc_board_init().
+ *
+ * @param[in] enable True to enable accounting
+ * @return True if the setting was changed, false if the driver is already registered
+ */
+extern bool acc_driver_os_linux_set_mem_accounting(bool enable);
+
+
+/**
+ * @brief Get the heap usage counted by the accounting
+ *
+ * @param[out] stats The heap usage
+ */
+extern void acc_driver_os_linux_mem_get_stats(acc_driver_os_linux_mem_stats_t *stats);
+
+
+/**
+ * @brief Get the heap usage per call site counted by the accounting
+ *
+ * @param[out] sites The call sites are returned here
+ * @param[in] max_count Size of the sites array
+ * @return Number of call sites returned
+ */
+extern size_t acc_driver_os_linux_mem_get_sites(acc_driver_os_linux_mem_site_t *sites, size_t max_count);
+
+
+/**
+ * @brief Print the heap usage, in total and per call site
+ *
+ * Call sites are resolved to symbol names when the executable exports them, linking with -rdynamic,
+ * otherwise the addresses can be resolved with addr2line.
+ *
+ * @param[in] file The file to print to
+ */
+extern void acc_driver_os_linux_mem_print_report(FILE *file);
+
+
+/**
+ * @brief Count an allocation
+ *
+ * Used by the OS driver when accounting is enabled.
+ *
+ * @param[in] site The call site
+ * @param[in] size The size of the allocation
+ * @return The call site index to pass to acc_driver_os_linux_mem_accounting_free()
+ */
+extern uint32_t acc_driver_os_linux_mem_accounting_alloc(const void *site, size_t size);
+
+
+/**
+ * @brief Count a free
+ *
+ * Used by the OS driver when accounting is enabled.
+ *
+ * @param[in] site The call site index of the allocation
+ * @param[in] size The size of the allocation
+ */
+extern void acc_driver_os_linux_mem_accounting_free(uint32_t site, size_t size);
+
+
+/**
+ * @brief Allocate memory from the pool allocator
+ *
+ * Allocations up to the largest size class are served from per-thread caches of fixed size
+ * blocks, refilled in batches from a shared pool per size class. Larger allocations are passed
+ * on to malloc().
+ *
+ * @param[in] size The number of bytes to allocate
+ * @return Pointer to the allocated memory, or NULL if allocation failed or size is zero
+ */
+extern void *acc_driver_os_linux_pool_alloc(size_t size);
+
+
+/**
+ * @brief Free memory allocated with acc_driver_os_linux_pool_alloc()
+ *
+ * The memory may be freed by any thread.
+ *
+ * @param[in] ptr The memory, NULL is allowed
+ */
+extern void acc_driver_os_linux_pool_free(void *ptr);
+
+
+/**
+ * @brief Get the statistics of the pool allocator
+ *
+ * @param[out] stats The statistics
+ */
+extern void acc_driver_os_linux_pool_get_stats(acc_driver_os_linux_pool_stats_t *stats);
+
+
+/**
+ * @brief Create an arena
+ *
+ * The memory of the arena is allocated once and reused by every scope on the arena.
+ *
+ * @param[in] capacity Size of the arena in bytes
+ * @return The arena, or NULL if it could not be created
+ */
+extern acc_driver_os_linux_arena_t acc_driver_os_linux_arena_create(size_t capacity);
+
+
+/**
+ * @brief Destroy an arena
+ *
+ * @param[in,out] arena The arena, set to NULL
+ */
+extern void acc_driver_os_linux_arena_destroy(acc_driver_os_linux_arena_t *arena);
+
+
+/**
+ * @brief Open an arena scope on the calling thread
+ *
+ * Until the scope is closed, acc_os_mem_alloc() on the calling thread bump-allocates from the arena
+ * and acc_os_mem_free() of arena memory does nothing. Allocations that do not fit in the arena are
+ * passed on to the registered allocator. Allocations on other threads are not affected.
+ *
+ * Everything allocated in the scope must be done with when the scope is closed, the memory is
+ * reused by the next scope. Objects that outlive the scope must be created before it is opened.
+ * Mutexes, semaphores and thread handles of the driver are never taken from the arena, so they may
+ * be created inside a scope, also when a driver creates them on first use.
+ *
+ * @param[in] arena The arena
+ * @return True if the scope was opened, false if a scope is already open on the thread or arena
+ */
+extern bool acc_driver_os_linux_arena_scope_begin(acc_driver_os_linux_arena_t arena);
+
+
+/**
+ * @brief Close the arena scope of the calling thread, releasing everything allocated in it at once
+ */
+extern void acc_driver_os_linux_arena_scope_end(void);
+
+
+/**
+ * @brief Get the usage of an arena
+ *
+ * @param[in] arena The arena
+ * @param[out] stats The usage
+ */
+extern void acc_driver_os_linux_arena_get_stats(acc_driver_os_linux_arena_t arena, acc_driver_os_linux_arena_stats_t *stats);
+
+
+/**
+ * @brief Allocate from the arena scope of the calling thread
+ *
+ * Used by the OS driver in front of the registered allocator.
+ *
+ * @param[in] size The number of bytes to allocate
+ * @return Pointer to the allocated memory, or NULL if no scope is open or the arena is full
+ */
+extern void *acc_driver_os_linux_arena_alloc(size_t size);
+
+
+/**
+ * @brief Free arena memory
+ *
+ * Used by the OS driver in front of the registered allocator. Arena memory is only released when
+ * the scope is closed, so this does nothing except telling if the memory belongs to an arena.
+ *
+ * @param[in] ptr The memory
+ * @return True if the memory belongs to an arena
+ */
+extern bool acc_driver_os_linux_arena_free(void *ptr);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -58,6 +58,51 @@ extern void acc_rss_deactivate(void);
 extern const char *acc_rss_version(void);
 
 
+/**
+ * @brief Get the calibration context of a sensor
+ *
+ * The sensor must have been calibrated, i.e. a service must have been activated on it since RSS was
+ * activated. The returned context must be destroyed with acc_rss_calibration_context_destroy().
+ *
+ * @param[in] sensor_id The sensor to get the calibration context for
+ * @return The calibration context, or NULL if the sensor is not calibrated
+ */
+extern acc_context_t acc_rss_calibration_context_get(acc_sensor_id_t sensor_id);
+
+
+/**
+ * @brief Set a previously retrieved calibration context for a sensor
+ *
+ * The calibration steps are skipped the next time a service is activated on the sensor.
+ * Must not be called while a service is active.
+ *
+ * @param[in] sensor_id The sensor to set the calibration context for
+ * @param[in] calibration_context The calibration context
+ * @return True if the calibration context was set
+ */
+extern bool acc_rss_calibration_context_set(acc_sensor_id_t sensor_id, acc_context_t calibration_context);
+
+
+/**
+ * @brief Reset the calibration of a sensor
+ *
+ * The sensor is calibrated again the next time a service is activated on it.
+ * Must not be called while a service is active.
+ *
+ * @param[in] sensor_id The sensor to reset calibration for
+ * @return True if the calibration was reset
+ */
+extern bool acc_rss_calibration_reset(acc_sensor_id_t sensor_id);
+
+
+/**
+ * @brief Destroy a calibration context
+ *
+ * @param[in] calibration_context The calibration context to destroy, set to NULL on return
+ */
+extern void acc_rss_calibration_context_destroy(acc_context_t *calibration_context);
+
+
 /**
  * @}
  */
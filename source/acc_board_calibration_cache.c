@@ -0,0 +1,296 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+// needed for ftruncate
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "acc_board.h"
+#include "acc_board_calibration_cache.h"
+#include "acc_board_eeprom.h"
+#include "acc_definitions.h"
+#include "acc_log.h"
+#include "acc_rss.h"
+#include "acc_types.h"
+
+
+/**
+ * @brief The module name
+ */
+#define MODULE "board_calibration_cache"
+
+#define CACHE_MAGIC		(0x43434341)	/**< @brief "ACCC" stored little endian */
+#define CACHE_VERSION		(1)
+#define CACHE_SLOT_COUNT	(8)		/**< @brief Number of stored calibrations */
+#define CACHE_DATA_SIZE_MAX	(2048)		/**< @brief Maximum size of one serialized calibration */
+
+
+/**
+ * @brief One stored calibration
+ */
+typedef struct {
+	uint32_t	in_use;
+	uint32_t	generation;
+	uint32_t	sensor;
+	uint32_t	board_serial;
+	float		ref_freq;
+	int32_t		temperature;
+	uint32_t	data_size;
+	uint8_t		data[CACHE_DATA_SIZE_MAX];
+} cache_slot_t;
+
+
+/**
+ * @brief Layout of the cache file
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	generation;
+	uint32_t	slot_count;
+	cache_slot_t	slots[CACHE_SLOT_COUNT];
+} cache_file_t;
+
+
+/**
+ * @brief Mutex to protect the cache
+ */
+static pthread_mutex_t	cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The memory-mapped cache file, NULL if the cache is not open
+ */
+static cache_file_t	*cache = NULL;
+
+/**
+ * @brief Serial number of the board, 0 if the board EEPROM could not be read
+ */
+static uint32_t		board_serial = 0;
+
+
+/**
+ * @brief Check if a stored calibration was made on this board with the current reference frequency
+ *
+ * @param[in] slot The stored calibration
+ * @param[in] sensor The sensor
+ * @param[in] ref_freq The current reference frequency
+ * @return True if the stored calibration belongs to the sensor
+ */
+static bool slot_matches_sensor(const cache_slot_t *slot, acc_sensor_t sensor, float ref_freq)
+{
+	return slot->in_use && (slot->sensor == sensor) && (slot->board_serial == board_serial) && (slot->ref_freq == ref_freq);
+}
+
+
+/**
+ * @brief Check if a stored calibration was made at a temperature close to the current one
+ *
+ * @param[in] slot The stored calibration
+ * @param[in] temperature The current temperature
+ * @return True if the temperatures match
+ */
+static bool slot_matches_temperature(const cache_slot_t *slot, int_fast16_t temperature)
+{
+	if ((slot->temperature == ACC_BOARD_CALIBRATION_CACHE_TEMPERATURE_UNKNOWN) ||
+	    (temperature == ACC_BOARD_CALIBRATION_CACHE_TEMPERATURE_UNKNOWN)) {
+		return slot->temperature == temperature;
+	}
+
+	int_fast32_t difference = slot->temperature - temperature;
+
+	return (difference <= ACC_BOARD_CALIBRATION_CACHE_TEMPERATURE_TOLERANCE) &&
+	       (difference >= -ACC_BOARD_CALIBRATION_CACHE_TEMPERATURE_TOLERANCE);
+}
+
+
+/**
+ * @brief Select the slot to store a new calibration in
+ *
+ * The slot of the same sensor is reused, otherwise a free slot or the oldest slot is used.
+ *
+ * @param[in] sensor The sensor
+ * @param[in] ref_freq The current reference frequency
+ * @return The slot
+ */
+static cache_slot_t *select_slot(acc_sensor_t sensor, float ref_freq)
+{
+	cache_slot_t *oldest = &cache->slots[0];
+
+	for (uint_fast8_t index = 0; index < CACHE_SLOT_COUNT; index++) {
+		cache_slot_t *slot = &cache->slots[index];
+
+		if (slot_matches_sensor(slot, sensor, ref_freq)) {
+			return slot;
+		}
+		if (!slot->in_use) {
+			oldest = slot;
+		} else if (oldest->in_use && (slot->generation < oldest->generation)) {
+			oldest = slot;
+		}
+	}
+
+	return oldest;
+}
+
+
+acc_status_t acc_board_calibration_cache_open(const char *path)
+{
+	acc_board_eeprom_t eeprom;
+
+	pthread_mutex_lock(&cache_mutex);
+
+	if (cache != NULL) {
+		pthread_mutex_unlock(&cache_mutex);
+		return ACC_STATUS_SUCCESS;
+	}
+
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		ACC_LOG_ERROR("Unable to open calibration cache %s: %s", path, strerror(errno));
+		pthread_mutex_unlock(&cache_mutex);
+		return ACC_STATUS_FAILURE;
+	}
+
+	if (ftruncate(fd, sizeof(cache_file_t)) < 0) {
+		ACC_LOG_ERROR("Unable to resize calibration cache %s: %s", path, strerror(errno));
+		close(fd);
+		pthread_mutex_unlock(&cache_mutex);
+		return ACC_STATUS_FAILURE;
+	}
+
+	void *map = mmap(NULL, sizeof(cache_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		ACC_LOG_ERROR("Unable to map calibration cache %s: %s", path, strerror(errno));
+		pthread_mutex_unlock(&cache_mutex);
+		return ACC_STATUS_FAILURE;
+	}
+
+	cache = map;
+
+	if ((cache->magic != CACHE_MAGIC) || (cache->version != CACHE_VERSION) || (cache->slot_count != CACHE_SLOT_COUNT)) {
+		ACC_LOG_VERBOSE("Initializing calibration cache %s", path);
+		memset(cache, 0, sizeof(*cache));
+		cache->magic		= CACHE_MAGIC;
+		cache->version		= CACHE_VERSION;
+		cache->slot_count	= CACHE_SLOT_COUNT;
+		msync(cache, sizeof(*cache), MS_SYNC);
+	}
+
+	board_serial = (acc_board_eeprom_read(&eeprom) == ACC_STATUS_SUCCESS) ? eeprom.board_serial : 0;
+
+	pthread_mutex_unlock(&cache_mutex);
+
+	return ACC_STATUS_SUCCESS;
+}
+
+
+void acc_board_calibration_cache_close(void)
+{
+	pthread_mutex_lock(&cache_mutex);
+
+	if (cache != NULL) {
+		munmap(cache, sizeof(*cache));
+		cache = NULL;
+	}
+
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+
+bool acc_board_calibration_cache_restore(acc_sensor_t sensor, int_fast16_t temperature)
+{
+	bool	restored = false;
+	float	ref_freq = acc_board_get_ref_freq();
+
+	pthread_mutex_lock(&cache_mutex);
+
+	if (cache == NULL) {
+		pthread_mutex_unlock(&cache_mutex);
+		return false;
+	}
+
+	for (uint_fast8_t index = 0; index < CACHE_SLOT_COUNT; index++) {
+		cache_slot_t *slot = &cache->slots[index];
+
+		if (slot_matches_sensor(slot, sensor, ref_freq) && slot_matches_temperature(slot, temperature)) {
+			acc_context_s context = {
+				.data		= slot->data,
+				.data_size	= slot->data_size
+			};
+
+			restored = acc_rss_calibration_context_set(sensor, &context);
+			if (!restored) {
+				ACC_LOG_WARNING("Stored calibration for sensor %" PRIsensor " was rejected", sensor);
+			}
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&cache_mutex);
+
+	return restored;
+}
+
+
+bool acc_board_calibration_cache_store(acc_sensor_t sensor, int_fast16_t temperature)
+{
+	float		ref_freq = acc_board_get_ref_freq();
+	acc_context_t	context;
+
+	pthread_mutex_lock(&cache_mutex);
+
+	if (cache == NULL) {
+		pthread_mutex_unlock(&cache_mutex);
+		return false;
+	}
+
+	context = acc_rss_calibration_context_get(sensor);
+	if (context == NULL) {
+		ACC_LOG_WARNING("No calibration available for sensor %" PRIsensor, sensor);
+		pthread_mutex_unlock(&cache_mutex);
+		return false;
+	}
+
+	if (context->data_size > CACHE_DATA_SIZE_MAX) {
+		ACC_LOG_ERROR("Calibration for sensor %" PRIsensor " is too large (%u bytes)", sensor, (unsigned int)context->data_size);
+		acc_rss_calibration_context_destroy(&context);
+		pthread_mutex_unlock(&cache_mutex);
+		return false;
+	}
+
+	cache_slot_t *slot = select_slot(sensor, ref_freq);
+
+	// Invalidate the slot while it is updated so a crash never leaves a half written calibration behind
+	slot->in_use = 0;
+	msync(cache, sizeof(*cache), MS_SYNC);
+
+	slot->generation	= ++cache->generation;
+	slot->sensor		= sensor;
+	slot->board_serial	= board_serial;
+	slot->ref_freq		= ref_freq;
+	slot->temperature	= temperature;
+	slot->data_size		= context->data_size;
+	memcpy(slot->data, context->data, context->data_size);
+	msync(cache, sizeof(*cache), MS_SYNC);
+
+	slot->in_use = 1;
+	msync(cache, sizeof(*cache), MS_SYNC);
+
+	acc_rss_calibration_context_destroy(&context);
+
+	pthread_mutex_unlock(&cache_mutex);
+
+	return true;
+}
@@ -0,0 +1,427 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "acc_board_eeprom.h"
+#include "acc_device_i2c.h"
+#include "acc_driver_i2c_linux.h"
+#include "acc_log.h"
+#include "acc_types.h"
+
+
+/**
+ * @brief The module name
+ */
+#define MODULE "board_eeprom"
+
+#define EEPROM_DEVICE_ID		(0x50)		/**< @brief I2C device ID of the board EEPROM */
+#define EEPROM_MAGIC			(0x45434341)	/**< @brief "ACCE" stored little endian */
+#define EEPROM_LAYOUT_VERSION		(1)
+
+#define EEPROM_HEADER_SIZE		(16)
+#define EEPROM_PAYLOAD_SIZE		(24 + (ACC_BOARD_EEPROM_SENSOR_COUNT_MAX * ACC_BOARD_EEPROM_CALIBRATION_SIZE))
+#define EEPROM_IMAGE_SIZE		(EEPROM_HEADER_SIZE + EEPROM_PAYLOAD_SIZE)
+
+#define EEPROM_CACHE_DIR_DEFAULT	"/var/cache/acconeer"
+#define EEPROM_CACHE_FILE		"%s/board_eeprom_%08" PRIx32 ".bin"
+#define EEPROM_CACHE_PATH_MAX		(256)
+
+/**
+ * @brief Byte offsets in the EEPROM image
+ */
+/**@{*/
+#define OFFSET_MAGIC			(0)
+#define OFFSET_LAYOUT_VERSION		(4)
+#define OFFSET_IMAGE_SIZE		(6)
+#define OFFSET_BOARD_SERIAL		(8)
+#define OFFSET_PAYLOAD_CRC		(12)
+#define OFFSET_BOARD_ID			(EEPROM_HEADER_SIZE + 0)
+#define OFFSET_BOARD_REVISION		(EEPROM_HEADER_SIZE + 2)
+#define OFFSET_REF_FREQ			(EEPROM_HEADER_SIZE + 4)
+#define OFFSET_REF_FREQ_TRIM		(EEPROM_HEADER_SIZE + 8)
+#define OFFSET_CALIBRATION		(EEPROM_HEADER_SIZE + 24)
+/**@}*/
+
+
+/**
+ * @brief Mutex to protect the cached EEPROM contents and the state of the read
+ */
+static pthread_mutex_t		eeprom_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Signaled when a read of the EEPROM is done
+ */
+static pthread_cond_t		eeprom_read_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief EEPROM contents kept in memory after a successful read
+ */
+static acc_board_eeprom_t	eeprom_data;
+
+/**
+ * @brief True when the status of the last read, and on success its contents, are kept until invalidated
+ */
+static bool			read_done = false;
+static acc_status_t		read_status = ACC_STATUS_SUCCESS;
+
+/**
+ * @brief State of the read queued to the I2C worker thread
+ */
+static bool			read_in_progress = false;
+static bool			read_invalidated = false;
+static uint8_t			read_image[EEPROM_IMAGE_SIZE];
+static char			read_cache_path[EEPROM_CACHE_PATH_MAX];
+static const char		*read_cache_dir = NULL;
+
+/**
+ * @brief Directory of the cache files, NULL if the file cache is disabled
+ */
+static const char		*cache_dir = EEPROM_CACHE_DIR_DEFAULT;
+
+
+static uint16_t get_u16(const uint8_t *buffer)
+{
+	return (uint16_t)buffer[0] | ((uint16_t)buffer[1] << 8);
+}
+
+
+static uint32_t get_u32(const uint8_t *buffer)
+{
+	return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+
+/**
+ * @brief Calculate CRC-32 (IEEE 802.3) of a buffer
+ *
+ * @param[in] buffer The data
+ * @param[in] size The size of the data
+ * @return The CRC
+ */
+static uint32_t crc32(const uint8_t *buffer, size_t size)
+{
+	uint32_t crc = 0xffffffff;
+
+	for (size_t index = 0; index < size; index++) {
+		crc ^= buffer[index];
+		for (uint_fast8_t bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+		}
+	}
+
+	return ~crc;
+}
+
+
+/**
+ * @brief Check that an EEPROM header describes an image this module can decode
+ *
+ * @param[in] header The header
+ * @return True if the header is valid
+ */
+static bool header_is_valid(const uint8_t *header)
+{
+	if (get_u32(&header[OFFSET_MAGIC]) != EEPROM_MAGIC) {
+		ACC_LOG_VERBOSE("Board EEPROM is not programmed");
+		return false;
+	}
+
+	if (get_u16(&header[OFFSET_LAYOUT_VERSION]) != EEPROM_LAYOUT_VERSION) {
+		ACC_LOG_WARNING("Unsupported board EEPROM layout version %u", (unsigned int)get_u16(&header[OFFSET_LAYOUT_VERSION]));
+		return false;
+	}
+
+	if (get_u16(&header[OFFSET_IMAGE_SIZE]) != EEPROM_IMAGE_SIZE) {
+		ACC_LOG_WARNING("Unexpected board EEPROM image size %u", (unsigned int)get_u16(&header[OFFSET_IMAGE_SIZE]));
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Check that the payload of an image matches the CRC of its header
+ *
+ * @param[in] image The full EEPROM image
+ * @return True if the payload is intact
+ */
+static bool payload_is_valid(const uint8_t *image)
+{
+	return crc32(&image[EEPROM_HEADER_SIZE], EEPROM_PAYLOAD_SIZE) == get_u32(&image[OFFSET_PAYLOAD_CRC]);
+}
+
+
+/**
+ * @brief Load the image from the cache file of a board
+ *
+ * The cached image is only used if its header is identical to the header read from the EEPROM.
+ *
+ * @param[in] path The cache file
+ * @param[in] header The header read from the EEPROM
+ * @param[out] image The image is returned here
+ * @return True if a valid cached image was found
+ */
+static bool cache_load(const char *path, const uint8_t *header, uint8_t *image)
+{
+	FILE *file = fopen(path, "rb");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	size_t bytes_read = fread(image, 1, EEPROM_IMAGE_SIZE, file);
+	fclose(file);
+
+	if (bytes_read != EEPROM_IMAGE_SIZE) {
+		return false;
+	}
+
+	return (memcmp(image, header, EEPROM_HEADER_SIZE) == 0) && payload_is_valid(image);
+}
+
+
+/**
+ * @brief Store an image in the cache file of a board
+ *
+ * The image is written to a temporary file which is then renamed, so a reader never sees a partial file.
+ *
+ * @param[in] dir The directory of the cache file
+ * @param[in] path The cache file
+ * @param[in] image The full EEPROM image
+ */
+static void cache_store(const char *dir, const char *path, const uint8_t *image)
+{
+	char	tmp_path[EEPROM_CACHE_PATH_MAX + 4];
+	FILE	*file;
+
+	if ((mkdir(dir, 0755) < 0) && (errno != EEXIST)) {
+		ACC_LOG_WARNING("Unable to create board EEPROM cache directory %s: %s", dir, strerror(errno));
+		return;
+	}
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	file = fopen(tmp_path, "wb");
+	if (file == NULL) {
+		ACC_LOG_WARNING("Unable to create board EEPROM cache %s: %s", tmp_path, strerror(errno));
+		return;
+	}
+
+	size_t bytes_written = fwrite(image, 1, EEPROM_IMAGE_SIZE, file);
+
+	if ((fclose(file) != 0) || (bytes_written != EEPROM_IMAGE_SIZE) || (rename(tmp_path, path) != 0)) {
+		ACC_LOG_WARNING("Unable to write board EEPROM cache %s", path);
+		remove(tmp_path);
+	}
+}
+
+
+/**
+ * @brief Decode an EEPROM image
+ *
+ * @param[in] image The full EEPROM image
+ * @param[out] eeprom The decoded contents
+ */
+static void decode_image(const uint8_t *image, acc_board_eeprom_t *eeprom)
+{
+	eeprom->board_serial	= get_u32(&image[OFFSET_BOARD_SERIAL]);
+	eeprom->board_id	= get_u16(&image[OFFSET_BOARD_ID]);
+	eeprom->board_revision	= get_u16(&image[OFFSET_BOARD_REVISION]);
+	eeprom->ref_freq	= get_u32(&image[OFFSET_REF_FREQ]);
+
+	for (uint_fast8_t sensor = 0; sensor < ACC_BOARD_EEPROM_SENSOR_COUNT_MAX; sensor++) {
+		eeprom->ref_freq_trim_ppb[sensor] = (int32_t)get_u32(&image[OFFSET_REF_FREQ_TRIM + (sensor * 4)]);
+		memcpy(eeprom->calibration[sensor], &image[OFFSET_CALIBRATION + (sensor * ACC_BOARD_EEPROM_CALIBRATION_SIZE)],
+		       ACC_BOARD_EEPROM_CALIBRATION_SIZE);
+	}
+}
+
+
+static void read_start(void);
+
+
+/**
+ * @brief Finish a read of the EEPROM and wake the threads waiting for it
+ *
+ * A read that was invalidated while in progress is discarded and started again, and the waiting threads keep waiting.
+ *
+ * @param[in] status Status of the read
+ */
+static void read_finish(acc_status_t status)
+{
+	pthread_mutex_lock(&eeprom_mutex);
+
+	read_in_progress = false;
+
+	if (read_invalidated) {
+		read_invalidated = false;
+		read_start();
+	} else {
+		if (status == ACC_STATUS_SUCCESS) {
+			decode_image(read_image, &eeprom_data);
+		}
+
+		read_status	= status;
+		read_done	= true;
+	}
+
+	if (!read_in_progress) {
+		pthread_cond_broadcast(&eeprom_read_cond);
+	}
+
+	pthread_mutex_unlock(&eeprom_mutex);
+}
+
+
+/**
+ * @brief Check the payload read from the EEPROM, called from the I2C worker thread
+ */
+static void read_payload_done(acc_status_t status, void *user_data)
+{
+	(void)user_data;
+
+	if (status != ACC_STATUS_SUCCESS) {
+		ACC_LOG_ERROR("Unable to read board EEPROM: %s", acc_log_status_name(status));
+		read_finish(status);
+		return;
+	}
+
+	if (!payload_is_valid(read_image)) {
+		ACC_LOG_ERROR("Board EEPROM CRC mismatch");
+		read_finish(ACC_STATUS_FAILURE);
+		return;
+	}
+
+	if (read_cache_dir != NULL) {
+		cache_store(read_cache_dir, read_cache_path, read_image);
+	}
+
+	read_finish(ACC_STATUS_SUCCESS);
+}
+
+
+/**
+ * @brief Load the image from the cache file or queue the payload read, called from the I2C worker thread
+ */
+static void read_header_done(acc_status_t status, void *user_data)
+{
+	(void)user_data;
+
+	if (status != ACC_STATUS_SUCCESS) {
+		// Boards without an EEPROM, or without i2c-dev enabled, use the default reference frequency
+		ACC_LOG_VERBOSE("No board EEPROM: %s", acc_log_status_name(status));
+		read_finish(status);
+		return;
+	}
+
+	if (!header_is_valid(read_image)) {
+		read_finish(ACC_STATUS_FAILURE);
+		return;
+	}
+
+	if (read_cache_dir != NULL) {
+		uint8_t header[EEPROM_HEADER_SIZE];
+
+		memcpy(header, read_image, EEPROM_HEADER_SIZE);
+		snprintf(read_cache_path, sizeof(read_cache_path), EEPROM_CACHE_FILE, read_cache_dir, get_u32(&header[OFFSET_BOARD_SERIAL]));
+
+		if (cache_load(read_cache_path, header, read_image)) {
+			ACC_LOG_VERBOSE("Board EEPROM loaded from %s", read_cache_path);
+			read_finish(ACC_STATUS_SUCCESS);
+			return;
+		}
+
+		memcpy(read_image, header, EEPROM_HEADER_SIZE);
+	}
+
+	status = acc_driver_i2c_linux_read_async(EEPROM_DEVICE_ID, EEPROM_HEADER_SIZE, 2, &read_image[EEPROM_HEADER_SIZE], EEPROM_PAYLOAD_SIZE,
+	                                         read_payload_done, NULL);
+	if (status != ACC_STATUS_SUCCESS) {
+		read_finish(status);
+	}
+}
+
+
+/**
+ * @brief Queue a read of the EEPROM header to the I2C worker thread, unless the result is known or being read
+ *
+ * The header is followed by the cache file or the payload, see acc_board_eeprom_read().
+ * Must be called with eeprom_mutex locked.
+ */
+static void read_start(void)
+{
+	if (read_done || read_in_progress) {
+		return;
+	}
+
+	acc_status_t status = acc_device_i2c_init();
+
+	if (status == ACC_STATUS_SUCCESS) {
+		read_in_progress	= true;
+		read_cache_dir		= cache_dir;
+		status = acc_driver_i2c_linux_read_async(EEPROM_DEVICE_ID, 0, 2, read_image, EEPROM_HEADER_SIZE, read_header_done, NULL);
+	}
+
+	if (status != ACC_STATUS_SUCCESS) {
+		read_in_progress	= false;
+		read_status		= status;
+		read_done		= true;
+	}
+}
+
+
+void acc_board_eeprom_set_cache_dir(const char *path)
+{
+	pthread_mutex_lock(&eeprom_mutex);
+	cache_dir = path;
+	pthread_mutex_unlock(&eeprom_mutex);
+}
+
+
+void acc_board_eeprom_prefetch(void)
+{
+	pthread_mutex_lock(&eeprom_mutex);
+	read_start();
+	pthread_mutex_unlock(&eeprom_mutex);
+}
+
+
+acc_status_t acc_board_eeprom_read(acc_board_eeprom_t *eeprom)
+{
+	acc_status_t status = ACC_STATUS_SUCCESS;
+
+	pthread_mutex_lock(&eeprom_mutex);
+
+	read_start();
+	while (read_in_progress) {
+		pthread_cond_wait(&eeprom_read_cond, &eeprom_mutex);
+	}
+
+	if (read_status == ACC_STATUS_SUCCESS) {
+		*eeprom = eeprom_data;
+	} else {
+		status = read_status;
+	}
+
+	pthread_mutex_unlock(&eeprom_mutex);
+
+	return status;
+}
+
+
+void acc_board_eeprom_invalidate(void)
+{
+	pthread_mutex_lock(&eeprom_mutex);
+	read_done		= false;
+	read_invalidated	= read_in_progress;
+	pthread_mutex_unlock(&eeprom_mutex);
+}
@@ -6,7 +6,9 @@
 #include <stdlib.h>
 
 #include "acc_board.h"
+#include "acc_board_eeprom.h"
 #include "acc_device_gpio.h"
+#include "acc_device_spi.h"
 #include "acc_log.h"
 #include "acc_os.h"
 
@@ -16,6 +18,8 @@
 #include "acc_driver_spi_android.h"
 #include "acc_os_android.h"
 #elif defined(TARGET_OS_linux)
+#include <unistd.h>
+
 #include "acc_driver_gpio_linux_sysfs.h"
 #include "acc_driver_i2c_linux.h"
 #include "acc_driver_spi_linux_spidev.h"
@@ -54,22 +58,29 @@
 #define PIN_SENSOR_INTERRUPT_S3_3V3 (24)	/**< @brief Gpio Interrupt S3 BCM:24 J5:18, connect to sensor 3 GPIO 5 */
 #define PIN_SENSOR_INTERRUPT_S4_3V3 (25)	/**< @brief Gpio Interrupt S4 BCM:25 J5:22, connect to sensor 4 GPIO 5 */
 
-#define ACC_BOARD_REF_FREQ	(24000000)	/**< @brief The reference frequency assumes 26 MHz on reference board */
+#define ACC_BOARD_REF_FREQ	(24000000)	/**< @brief The reference frequency assumes 24 MHz on reference board */
+#define ACC_BOARD_REF_FREQ_MIN	(10000000)	/**< @brief The lowest reference frequency supported by the sensor */
+#define ACC_BOARD_REF_FREQ_MAX	(60000000)	/**< @brief The highest reference frequency supported by the sensor */
+#define ACC_BOARD_REF_FREQ_ENV	"ACC_BOARD_REF_FREQ"	/**< @brief Environment variable overriding the reference frequency [Hz] */
 #define ACC_BOARD_SPI_SPEED	(15000000)	/**< @brief The SPI speed of this board */
 
 
 
 /**
  * @brief Sensor states
+ *
+ * The state of a sensor is only changed with atomic compare-and-swap. SENSOR_BUSY is held by
+ * the thread starting, stopping or resetting the sensor, so other threads never act on a half-updated sensor.
  */
 typedef enum {
 	SENSOR_DISABLED,
 	SENSOR_ENABLED,
-	SENSOR_ENABLED_AND_SELECTED
+	SENSOR_ENABLED_AND_SELECTED,
+	SENSOR_BUSY
 } acc_board_sensor_state_t;
 
 typedef struct {
-	acc_board_sensor_state_t state;
+	uint32_t state;	/**< acc_board_sensor_state_t, only accessed atomically */
 	const uint8_t enable_pin;
 	const uint8_t interrupt_pin;
 	const uint8_t slave_select_pin;
@@ -103,12 +114,133 @@ static acc_sensor_pins_t sensor_pins[SENSOR_COUNT] = {
 };
 
 
+#if defined(TARGET_OS_linux)
+/**
+ * @brief A sensor transfer with bus, chip select, speed and file descriptors resolved
+ */
+struct acc_board_sensor_transfer_s {
+	acc_sensor_t		sensor;
+	acc_sensor_pins_t	*p_sensor;
+	uint_fast8_t		spi_bus;
+	uint32_t		spi_speed;
+	int			spi_fd;
+	int			slave_select_fd;	/**< Only accessed atomically, -1 until prepared */
+	bool			batching;		/**< Only accessed atomically */
+};
+
+static struct acc_board_sensor_transfer_s sensor_transfers[SENSOR_COUNT];
+#endif
+
+
+/**
+ * @brief The reference frequency of the board, only accessed atomically
+ */
+static float board_ref_freq = ACC_BOARD_REF_FREQ;
+
+/**
+ * @brief True when the reference frequency has been read or set, only accessed atomically
+ */
+static bool board_ref_freq_initialized = false;
+
+/**
+ * @brief Mutex serializing the first read and the setting of the reference frequency
+ */
+static acc_os_mutex_t board_ref_freq_mutex = NULL;
+
+
+/**
+ * @brief Number of sensors that are started, only accessed atomically
+ */
+static uint32_t active_sensor_count = 0;
+
+/**
+ * @brief Mutex to serialize powering the board up and down
+ *
+ * Only taken when a sensor is started or stopped, never when selecting a sensor.
+ */
+static acc_os_mutex_t board_power_mutex = NULL;
+
+/**
+ * @brief True if PMU_EN and ENABLE_N are set so that the board is powered, protected by board_power_mutex
+ */
+static bool board_powered = false;
+
+
 /**
  * @brief Private function to check if there is at least one active sensor
  *
  * @return True if there is at least one active sensor, false otherwise
  */
-static bool any_sensor_active();
+static bool any_sensor_active(void);
+
+
+/**
+ * @brief Private function to atomically read the state of a sensor
+ *
+ * @param[in] p_sensor The sensor
+ * @return The state
+ */
+static acc_board_sensor_state_t sensor_state_get(acc_sensor_pins_t *p_sensor);
+
+
+/**
+ * @brief Private function to atomically change the state of a sensor
+ *
+ * @param[in] p_sensor The sensor
+ * @param[in] from The expected current state
+ * @param[in] to The new state
+ * @return True if the sensor was in the expected state and has been changed to the new state
+ */
+static bool sensor_state_transition(acc_sensor_pins_t *p_sensor, acc_board_sensor_state_t from, acc_board_sensor_state_t to);
+
+
+/**
+ * @brief Private function to power up the board if it is not already powered
+ *
+ * @param[in] sensor The sensor that requested the power, used for logging
+ * @return Status
+ */
+static acc_status_t board_power_up(acc_sensor_t sensor);
+
+
+/**
+ * @brief Private function to power down the board if no sensor is active
+ */
+static void board_power_down(void);
+
+
+/**
+ * @brief Private function to pick up the reference frequency from the board EEPROM or the environment
+ *
+ * The environment variable takes precedence over the EEPROM. Called on the first use of the
+ * reference frequency, so that programs that never start a sensor do not touch the EEPROM.
+ * The sensors of the board share one reference clock, so the mean of their EEPROM trims is applied.
+ */
+static void init_ref_freq(void);
+
+
+/**
+ * @brief Private function to store a reference frequency and mark it as initialized
+ *
+ * Called with board_ref_freq_mutex held, once it exists, so that the first read cannot overwrite an explicit setting.
+ *
+ * @param[in] ref_freq The reference frequency [Hz]
+ * @return True if the reference frequency is within range and was stored
+ */
+static bool store_ref_freq(float ref_freq);
+
+
+/**
+ * @brief Private function to set the level of the slave select pin of a sensor
+ *
+ * Once transfers to the sensor have been prepared the pin is written through its file descriptor.
+ * The GPIO driver then keeps believing the pin is high, so the pin must never be written through the driver again.
+ *
+ * @param[in] sensor The sensor
+ * @param[in] level The level to set
+ * @return Status
+ */
+static acc_status_t slave_select_write(acc_sensor_t sensor, uint_fast8_t level);
 
 
 acc_status_t acc_board_gpio_init(void)
@@ -214,6 +346,21 @@ acc_status_t acc_board_init(void)
 		acc_os_mutex_unlock(init_mutex);
 		return ACC_STATUS_SUCCESS;
 	}
+
+	board_power_mutex = acc_os_mutex_create();
+	if (board_power_mutex == NULL) {
+		ACC_LOG_ERROR("Failed to create board power mutex");
+		acc_os_mutex_unlock(init_mutex);
+		return ACC_STATUS_OUT_OF_MEMORY;
+	}
+
+	board_ref_freq_mutex = acc_os_mutex_create();
+	if (board_ref_freq_mutex == NULL) {
+		ACC_LOG_ERROR("Failed to create reference frequency mutex");
+		acc_os_mutex_unlock(init_mutex);
+		return ACC_STATUS_OUT_OF_MEMORY;
+	}
+
 #if defined(TARGET_OS_android)
 	acc_driver_gpio_android_register(28);
 	acc_driver_spi_android_register();
@@ -228,6 +375,12 @@ acc_status_t acc_board_init(void)
 #error "Target operating system not supported"
 #endif
 
+#if defined(TARGET_OS_linux)
+	for (uint_fast8_t i = 0; i < SENSOR_COUNT; i++) {
+		sensor_transfers[i].slave_select_fd = -1;
+	}
+#endif
+
 	init_done = true;
 	acc_os_mutex_unlock(init_mutex);
 
@@ -235,31 +388,99 @@ acc_status_t acc_board_init(void)
 }
 
 
-static bool any_sensor_active(){
-	for (uint_fast8_t i = 0; i < SENSOR_COUNT; i++) {
-		if (sensor_pins[i].state != SENSOR_DISABLED) {
-			return true;
+static void init_ref_freq(void)
+{
+	acc_board_eeprom_t	eeprom;
+	const char		*ref_freq_env = getenv(ACC_BOARD_REF_FREQ_ENV);
+
+	if (ref_freq_env != NULL) {
+		if (!store_ref_freq(strtof(ref_freq_env, NULL))) {
+			ACC_LOG_WARNING("Ignoring %s=%s", ACC_BOARD_REF_FREQ_ENV, ref_freq_env);
+		} else {
+			return;
 		}
 	}
-	return false;
+
+	if (acc_board_eeprom_read(&eeprom) != ACC_STATUS_SUCCESS) {
+		return;
+	}
+
+	uint_fast8_t	trim_count = (SENSOR_COUNT < ACC_BOARD_EEPROM_SENSOR_COUNT_MAX) ? SENSOR_COUNT : ACC_BOARD_EEPROM_SENSOR_COUNT_MAX;
+	int64_t		trim_sum_ppb = 0;
+
+	for (uint_fast8_t sensor = 0; sensor < trim_count; sensor++) {
+		trim_sum_ppb += eeprom.ref_freq_trim_ppb[sensor];
+	}
+
+	if ((eeprom.ref_freq != 0) || (trim_sum_ppb != 0)) {
+		double ref_freq = (eeprom.ref_freq != 0) ? eeprom.ref_freq : ACC_BOARD_REF_FREQ;
+
+		store_ref_freq((float)(ref_freq * (1.0 + ((double)trim_sum_ppb / trim_count) / 1e9)));
+	}
 }
 
 
-acc_status_t acc_board_start_sensor(acc_sensor_t sensor)
+static bool store_ref_freq(float ref_freq)
 {
-	acc_status_t status = ACC_STATUS_FAILURE;
-	acc_sensor_pins_t *p_sensor = &sensor_pins[sensor - 1];
+	if ((ref_freq < ACC_BOARD_REF_FREQ_MIN) || (ref_freq > ACC_BOARD_REF_FREQ_MAX)) {
+		ACC_LOG_ERROR("Reference frequency %" PRIu32 " Hz is out of range", (uint32_t)ref_freq);
+		return false;
+	}
 
-	if (p_sensor->state != SENSOR_DISABLED) {
-		ACC_LOG_ERROR("Sensor %"PRIsensor" already enabled.", sensor);
-		return status;
+	__atomic_store(&board_ref_freq, &ref_freq, __ATOMIC_RELAXED);
+	__atomic_store_n(&board_ref_freq_initialized, true, __ATOMIC_RELEASE);
+	ACC_LOG_VERBOSE("Reference frequency set to %" PRIu32 " Hz", (uint32_t)ref_freq);
+
+	return true;
+}
+
+
+static bool any_sensor_active(void)
+{
+	return __atomic_load_n(&active_sensor_count, __ATOMIC_ACQUIRE) != 0;
+}
+
+
+static acc_board_sensor_state_t sensor_state_get(acc_sensor_pins_t *p_sensor)
+{
+	return __atomic_load_n(&p_sensor->state, __ATOMIC_ACQUIRE);
+}
+
+
+static bool sensor_state_transition(acc_sensor_pins_t *p_sensor, acc_board_sensor_state_t from, acc_board_sensor_state_t to)
+{
+	uint32_t expected = from;
+
+	return __atomic_compare_exchange_n(&p_sensor->state, &expected, to, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+
+static acc_status_t slave_select_write(acc_sensor_t sensor, uint_fast8_t level)
+{
+#if defined(TARGET_OS_linux)
+	int fd = __atomic_load_n(&sensor_transfers[sensor - 1].slave_select_fd, __ATOMIC_ACQUIRE);
+
+	if (fd >= 0) {
+		return (write(fd, (level == PIN_LOW) ? "0" : "1", 1) == 1) ? ACC_STATUS_SUCCESS : ACC_STATUS_FAILURE;
 	}
+#endif
+
+	return acc_device_gpio_write(sensor_pins[sensor - 1].slave_select_pin, level);
+}
 
-	if (!any_sensor_active()) {
+
+static acc_status_t board_power_up(acc_sensor_t sensor)
+{
+	acc_status_t status = ACC_STATUS_SUCCESS;
+
+	acc_os_mutex_lock(board_power_mutex);
+
+	if (!board_powered) {
 		// No active sensors yet, set pmu high to start the board
 		status = acc_device_gpio_write(PIN_PMU_EN, PIN_HIGH);
 		if (status != ACC_STATUS_SUCCESS) {
 			ACC_LOG_ERROR("Couldn't enable pmu for sensor %"PRIsensor, sensor);
+			acc_os_mutex_unlock(board_power_mutex);
 			return status;
 		}
 		// Wait for the board to power up
@@ -267,19 +488,67 @@ acc_status_t acc_board_start_sensor(acc_sensor_t sensor)
 		status = acc_device_gpio_write(PIN_ENABLE_N, PIN_LOW);
 		if (status != ACC_STATUS_SUCCESS) {
 			ACC_LOG_ERROR("Couldn't set enable to low for sensor %"PRIsensor, sensor);
+			acc_os_mutex_unlock(board_power_mutex);
 			return status;
 		}
 		acc_os_sleep_us(5000);
+
+		board_powered = true;
+	}
+
+	acc_os_mutex_unlock(board_power_mutex);
+
+	return status;
+}
+
+
+static void board_power_down(void)
+{
+	acc_os_mutex_lock(board_power_mutex);
+
+	// A sensor may have been started since the caller saw the count reach zero
+	if (board_powered && !any_sensor_active()) {
+		// No active sensors, shut down the board to save power
+		acc_device_gpio_write(PIN_ENABLE_N, PIN_HIGH);
+		acc_device_gpio_write(PIN_PMU_EN, PIN_LOW);
+		board_powered = false;
+	}
+
+	acc_os_mutex_unlock(board_power_mutex);
+}
+
+
+acc_status_t acc_board_start_sensor(acc_sensor_t sensor)
+{
+	acc_status_t status = ACC_STATUS_FAILURE;
+	acc_sensor_pins_t *p_sensor = &sensor_pins[sensor - 1];
+
+	if (!sensor_state_transition(p_sensor, SENSOR_DISABLED, SENSOR_BUSY)) {
+		ACC_LOG_ERROR("Sensor %"PRIsensor" already enabled.", sensor);
+		return status;
+	}
+
+	__atomic_add_fetch(&active_sensor_count, 1, __ATOMIC_ACQ_REL);
+
+	status = board_power_up(sensor);
+	if (status != ACC_STATUS_SUCCESS) {
+		__atomic_sub_fetch(&active_sensor_count, 1, __ATOMIC_ACQ_REL);
+		__atomic_store_n(&p_sensor->state, SENSOR_DISABLED, __ATOMIC_RELEASE);
+		return status;
 	}
 
 	status = acc_device_gpio_write(p_sensor->enable_pin, PIN_HIGH);
 	if (status != ACC_STATUS_SUCCESS) {
 		ACC_LOG_ERROR("Unable to activate ENABLE on sensor %"PRIsensor, sensor);
+		__atomic_store_n(&p_sensor->state, SENSOR_DISABLED, __ATOMIC_RELEASE);
+		if (__atomic_sub_fetch(&active_sensor_count, 1, __ATOMIC_ACQ_REL) == 0) {
+			board_power_down();
+		}
 		return status;
 	}
 	acc_os_sleep_us(5000);
 
-	p_sensor->state = SENSOR_ENABLED;
+	__atomic_store_n(&p_sensor->state, SENSOR_ENABLED, __ATOMIC_RELEASE);
 
 	return status;
 }
@@ -289,39 +558,110 @@ acc_status_t acc_board_stop_sensor(acc_sensor_t sensor)
 {
 	acc_status_t status = ACC_STATUS_FAILURE;
 	acc_sensor_pins_t *p_sensor = &sensor_pins[sensor - 1];
+	acc_board_sensor_state_t state = sensor_state_get(p_sensor);
 
-	if (p_sensor->state != SENSOR_DISABLED) {
-		// "unselect" spi slave select
-		if (p_sensor->state == SENSOR_ENABLED_AND_SELECTED) {
-			status = acc_device_gpio_write(p_sensor->slave_select_pin, PIN_HIGH);
-			if (status != ACC_STATUS_SUCCESS) {
-				ACC_LOG_ERROR("Failed to deselect sensor %"PRIsensor, sensor);
-				return status;
-			}
-		}
+	// Claim the sensor, retry if it is selected or deselected concurrently
+	while (((state == SENSOR_ENABLED) || (state == SENSOR_ENABLED_AND_SELECTED)) &&
+	       !sensor_state_transition(p_sensor, state, SENSOR_BUSY)) {
+		state = sensor_state_get(p_sensor);
+	}
 
-		// Disable sensor
-		status = acc_device_gpio_write(p_sensor->enable_pin, PIN_LOW);
+	if ((state != SENSOR_ENABLED) && (state != SENSOR_ENABLED_AND_SELECTED)) {
+		ACC_LOG_ERROR("Sensor %"PRIsensor" already inactive", sensor);
+		return status;
+	}
+
+	// "unselect" spi slave select
+	if (state == SENSOR_ENABLED_AND_SELECTED) {
+		status = slave_select_write(sensor, PIN_HIGH);
 		if (status != ACC_STATUS_SUCCESS) {
-			// Set the state to enabled since it is not selected and failed to disable
-			p_sensor->state = SENSOR_ENABLED;
-			ACC_LOG_ERROR("Unable to deactivate ENABLE on sensor %"PRIsensor, sensor);
+			ACC_LOG_ERROR("Failed to deselect sensor %"PRIsensor, sensor);
+			__atomic_store_n(&p_sensor->state, state, __ATOMIC_RELEASE);
 			return status;
 		}
-		p_sensor->state = SENSOR_DISABLED;
-	} else {
-		ACC_LOG_ERROR("Sensor %"PRIsensor" already inactive", sensor);
 	}
-	if (!any_sensor_active()) {
-		// No active sensors, shut down the board to save power
-		acc_device_gpio_write(PIN_ENABLE_N, PIN_HIGH);
-		acc_device_gpio_write(PIN_PMU_EN, PIN_LOW);
+
+	// Disable sensor
+	status = acc_device_gpio_write(p_sensor->enable_pin, PIN_LOW);
+	if (status != ACC_STATUS_SUCCESS) {
+		// Set the state to enabled since it is not selected and failed to disable
+		__atomic_store_n(&p_sensor->state, SENSOR_ENABLED, __ATOMIC_RELEASE);
+		ACC_LOG_ERROR("Unable to deactivate ENABLE on sensor %"PRIsensor, sensor);
+		return status;
+	}
+	__atomic_store_n(&p_sensor->state, SENSOR_DISABLED, __ATOMIC_RELEASE);
+
+	if (__atomic_sub_fetch(&active_sensor_count, 1, __ATOMIC_ACQ_REL) == 0) {
+		board_power_down();
 	}
 
 	return status;
 }
 
 
+acc_status_t acc_board_reset_sensor(acc_sensor_t sensor)
+{
+	acc_status_t status = ACC_STATUS_FAILURE;
+	acc_sensor_pins_t *p_sensor = &sensor_pins[sensor - 1];
+	acc_board_sensor_state_t state = sensor_state_get(p_sensor);
+
+	// Claim the sensor, retry if it is selected or deselected concurrently
+	while (((state == SENSOR_ENABLED) || (state == SENSOR_ENABLED_AND_SELECTED)) &&
+	       !sensor_state_transition(p_sensor, state, SENSOR_BUSY)) {
+		state = sensor_state_get(p_sensor);
+	}
+
+	if (state == SENSOR_DISABLED) {
+		// ENABLE is already low, the sensor is power cycled when it is started again
+		return ACC_STATUS_SUCCESS;
+	}
+
+	if ((state != SENSOR_ENABLED) && (state != SENSOR_ENABLED_AND_SELECTED)) {
+		ACC_LOG_ERROR("Cannot reset sensor %"PRIsensor", it is being started or stopped", sensor);
+		return status;
+	}
+
+	// "unselect" spi slave select, the slave select of other sensors is not touched
+	status = slave_select_write(sensor, PIN_HIGH);
+	if (status != ACC_STATUS_SUCCESS) {
+		ACC_LOG_ERROR("Failed to deselect sensor %"PRIsensor, sensor);
+		__atomic_store_n(&p_sensor->state, state, __ATOMIC_RELEASE);
+		return status;
+	}
+
+	status = acc_device_gpio_write(p_sensor->enable_pin, PIN_LOW);
+	if (status != ACC_STATUS_SUCCESS) {
+		ACC_LOG_ERROR("Unable to deactivate ENABLE on sensor %"PRIsensor, sensor);
+		__atomic_store_n(&p_sensor->state, SENSOR_ENABLED, __ATOMIC_RELEASE);
+		return status;
+	}
+	acc_os_sleep_us(5000);
+
+	status = acc_device_gpio_write(p_sensor->enable_pin, PIN_HIGH);
+	if (status != ACC_STATUS_SUCCESS) {
+		// The sensor is unpowered but still counted as active, so the board stays powered for the others
+		ACC_LOG_ERROR("Unable to activate ENABLE on sensor %"PRIsensor, sensor);
+		__atomic_store_n(&p_sensor->state, SENSOR_ENABLED, __ATOMIC_RELEASE);
+		return status;
+	}
+	acc_os_sleep_us(5000);
+
+	__atomic_store_n(&p_sensor->state, SENSOR_ENABLED, __ATOMIC_RELEASE);
+
+	ACC_LOG_INFO("Sensor %"PRIsensor" has been reset", sensor);
+
+	return ACC_STATUS_SUCCESS;
+}
+
+
+bool acc_board_is_sensor_started(acc_sensor_t sensor)
+{
+	acc_board_sensor_state_t state = sensor_state_get(&sensor_pins[sensor - 1]);
+
+	return (state == SENSOR_ENABLED) || (state == SENSOR_ENABLED_AND_SELECTED);
+}
+
+
 void acc_board_get_spi_bus_cs(acc_sensor_t sensor, uint_fast8_t *bus, uint_fast8_t *cs)
 {
 	if ((sensor == 0) || (sensor > SENSOR_COUNT)) {
@@ -340,49 +680,59 @@ acc_status_t acc_board_chip_select(acc_sensor_t sensor, uint_fast8_t cs_assert)
 	acc_sensor_pins_t *p_sensor = &sensor_pins[sensor - 1];
 
 	if (cs_assert) {
-		if (p_sensor->state == SENSOR_ENABLED) {
+		acc_board_sensor_state_t state = sensor_state_get(p_sensor);
+
+		if (state == SENSOR_ENABLED) {
 			// Since only one sensor can be active, loop through all the other sensors and deselect the active one
 			for (uint_fast8_t i = 0; i < SENSOR_COUNT; i++) {
-				if ((i != (sensor - 1)) && (sensor_pins[i].state == SENSOR_ENABLED_AND_SELECTED)) {
-					status = acc_device_gpio_write(sensor_pins[i].slave_select_pin, PIN_HIGH);
+				if ((i != (sensor - 1)) && sensor_state_transition(&sensor_pins[i], SENSOR_ENABLED_AND_SELECTED, SENSOR_ENABLED)) {
+					status = slave_select_write(i + 1, PIN_HIGH);
 					if (status != ACC_STATUS_SUCCESS) {
 						ACC_LOG_ERROR("Failed to deselect sensor %"PRIsensor", status %d", sensor, status);
+						sensor_state_transition(&sensor_pins[i], SENSOR_ENABLED, SENSOR_ENABLED_AND_SELECTED);
 						return ACC_STATUS_FAILURE;
 					}
-					sensor_pins[i].state = SENSOR_ENABLED;
 				}
 			}
 
 			// Select the sensor
-			status = acc_device_gpio_write(p_sensor->slave_select_pin, PIN_LOW);
+			status = slave_select_write(sensor, PIN_LOW);
 			if (status != ACC_STATUS_SUCCESS) {
 				ACC_LOG_ERROR("Failed to select sensor %"PRIsensor", status %d", sensor, status);
 				return status;
 			}
-			p_sensor->state = SENSOR_ENABLED_AND_SELECTED;
+
+			if (!sensor_state_transition(p_sensor, SENSOR_ENABLED, SENSOR_ENABLED_AND_SELECTED)) {
+				ACC_LOG_ERROR("Sensor %"PRIsensor" was stopped while being selected", sensor);
+				slave_select_write(sensor, PIN_HIGH);
+				return ACC_STATUS_FAILURE;
+			}
 
 			status = ACC_STATUS_SUCCESS;
 		}
-		else if (p_sensor->state == SENSOR_DISABLED) {
+		else if (state == SENSOR_DISABLED) {
 			ACC_LOG_ERROR("Failed to select sensor %"PRIsensor", it is disabled", sensor);
 		}
-		else if (p_sensor->state == SENSOR_ENABLED_AND_SELECTED) {
+		else if (state == SENSOR_ENABLED_AND_SELECTED) {
 			ACC_LOG_DEBUG("Sensor %"PRIsensor" already selected", sensor);
 			status = ACC_STATUS_SUCCESS;
 		}
+		else if (state == SENSOR_BUSY) {
+			ACC_LOG_ERROR("Failed to select sensor %"PRIsensor", it is being started or stopped", sensor);
+		}
 		else {
 			ACC_LOG_ERROR("Unknown state when selecting sensor %"PRIsensor, sensor);
 		}
 
 		return status;
 	} else {
-		if (p_sensor->state == SENSOR_ENABLED_AND_SELECTED) {
-			status = acc_device_gpio_write(p_sensor->slave_select_pin, PIN_HIGH);
+		if (sensor_state_transition(p_sensor, SENSOR_ENABLED_AND_SELECTED, SENSOR_ENABLED)) {
+			status = slave_select_write(sensor, PIN_HIGH);
 			if (status != ACC_STATUS_SUCCESS) {
 				ACC_LOG_ERROR("Failed to deselect sensor %"PRIsensor", status %d", sensor, status);
+				sensor_state_transition(p_sensor, SENSOR_ENABLED, SENSOR_ENABLED_AND_SELECTED);
 				return status;
 			}
-			p_sensor->state = SENSOR_ENABLED;
 		}
 	}
 
@@ -390,6 +740,120 @@ acc_status_t acc_board_chip_select(acc_sensor_t sensor, uint_fast8_t cs_assert)
 }
 
 
+acc_board_sensor_transfer_t acc_board_prepare_sensor_transfer(acc_sensor_t sensor)
+{
+#if defined(TARGET_OS_linux)
+	uint_fast8_t spi_device;
+
+	if ((sensor == 0) || (sensor > SENSOR_COUNT)) {
+		return NULL;
+	}
+
+	struct acc_board_sensor_transfer_s *transfer = &sensor_transfers[sensor - 1];
+
+	transfer->sensor = sensor;
+	transfer->p_sensor = &sensor_pins[sensor - 1];
+	acc_board_get_spi_bus_cs(sensor, &transfer->spi_bus, &spi_device);
+	transfer->spi_speed = acc_board_get_spi_speed(transfer->spi_bus);
+	transfer->spi_fd = acc_driver_spi_linux_spidev_get_fd(transfer->spi_bus, spi_device);
+	__atomic_store_n(&transfer->batching, false, __ATOMIC_RELEASE);
+
+	if (__atomic_load_n(&transfer->slave_select_fd, __ATOMIC_ACQUIRE) < 0) {
+		// The sensor is deselected, so the pin is high as the GPIO driver expects
+		__atomic_store_n(&transfer->slave_select_fd,
+		                 acc_driver_gpio_linux_sysfs_get_output_fd(transfer->p_sensor->slave_select_pin), __ATOMIC_RELEASE);
+	}
+
+	if ((transfer->spi_fd < 0) || (__atomic_load_n(&transfer->slave_select_fd, __ATOMIC_ACQUIRE) < 0)) {
+		ACC_LOG_VERBOSE("Transfers to sensor %"PRIsensor" could not be prepared", sensor);
+		return NULL;
+	}
+
+	return transfer;
+#else
+	ACC_UNUSED(sensor);
+
+	return NULL;
+#endif
+}
+
+
+#if defined(TARGET_OS_linux)
+/**
+ * @brief Note the time at which a transfer phase ended
+ *
+ * @param[out] phase_end_ns Phase end times [ns], nothing is done if NULL
+ * @param[in] phase The phase that ended
+ */
+static void transfer_phase_mark(uint64_t *phase_end_ns, acc_board_transfer_phase_t phase)
+{
+	if (phase_end_ns != NULL) {
+		phase_end_ns[phase] = acc_driver_os_linux_time_ns();
+	}
+}
+#endif
+
+
+acc_status_t acc_board_sensor_transfer(acc_board_sensor_transfer_t transfer, uint8_t *buffer, size_t buffer_size,
+                                       uint64_t *phase_end_ns)
+{
+#if defined(TARGET_OS_linux)
+	acc_status_t	status;
+
+	acc_device_spi_lock(transfer->spi_bus);
+	transfer_phase_mark(phase_end_ns, ACC_BOARD_TRANSFER_PHASE_LOCK);
+
+	// When batching, the sensor is still selected from the previous transfer unless another sensor was used since
+	if (sensor_state_get(transfer->p_sensor) != SENSOR_ENABLED_AND_SELECTED) {
+		status = acc_board_chip_select(transfer->sensor, 1);
+		if (status != ACC_STATUS_SUCCESS) {
+			acc_device_spi_unlock(transfer->spi_bus);
+			return status;
+		}
+	}
+	transfer_phase_mark(phase_end_ns, ACC_BOARD_TRANSFER_PHASE_CHIP_SELECT);
+
+	status = acc_driver_spi_linux_spidev_transfer_fd(transfer->spi_fd, transfer->spi_speed, buffer, buffer_size);
+	transfer_phase_mark(phase_end_ns, ACC_BOARD_TRANSFER_PHASE_SPI);
+
+	if ((status != ACC_STATUS_SUCCESS) || !__atomic_load_n(&transfer->batching, __ATOMIC_ACQUIRE)) {
+		if (acc_board_chip_select(transfer->sensor, 0) != ACC_STATUS_SUCCESS) {
+			status = ACC_STATUS_FAILURE;
+		}
+	}
+
+	acc_device_spi_unlock(transfer->spi_bus);
+	transfer_phase_mark(phase_end_ns, ACC_BOARD_TRANSFER_PHASE_DESELECT);
+
+	return status;
+#else
+	ACC_UNUSED(transfer);
+	ACC_UNUSED(buffer);
+	ACC_UNUSED(buffer_size);
+	ACC_UNUSED(phase_end_ns);
+
+	return ACC_STATUS_UNSUPPORTED;
+#endif
+}
+
+
+void acc_board_set_sensor_transfer_batching(acc_board_sensor_transfer_t transfer, bool batching)
+{
+#if defined(TARGET_OS_linux)
+	__atomic_store_n(&transfer->batching, batching, __ATOMIC_RELEASE);
+
+	if (!batching) {
+		acc_device_spi_lock(transfer->spi_bus);
+		acc_board_chip_select(transfer->sensor, 0);
+		acc_device_spi_unlock(transfer->spi_bus);
+	}
+#else
+	ACC_UNUSED(transfer);
+	ACC_UNUSED(batching);
+#endif
+}
+
+
 acc_sensor_t acc_board_get_sensor_count(void)
 {
 	return SENSOR_COUNT;
@@ -429,7 +893,20 @@ bool acc_board_is_sensor_interrupt_active(acc_sensor_t sensor)
 
 float acc_board_get_ref_freq(void)
 {
-	return ACC_BOARD_REF_FREQ;
+	if (!__atomic_load_n(&board_ref_freq_initialized, __ATOMIC_ACQUIRE) && (board_ref_freq_mutex != NULL)) {
+		acc_os_mutex_lock(board_ref_freq_mutex);
+		if (!__atomic_load_n(&board_ref_freq_initialized, __ATOMIC_ACQUIRE)) {
+			init_ref_freq();
+			__atomic_store_n(&board_ref_freq_initialized, true, __ATOMIC_RELEASE);
+		}
+		acc_os_mutex_unlock(board_ref_freq_mutex);
+	}
+
+	float ref_freq;
+
+	__atomic_load(&board_ref_freq, &ref_freq, __ATOMIC_RELAXED);
+
+	return ref_freq;
 }
 
 
@@ -443,7 +920,15 @@ uint32_t acc_board_get_spi_speed(uint_fast8_t bus)
 
 acc_status_t acc_board_set_ref_freq(float ref_freq)
 {
-	ACC_UNUSED(ref_freq);
+	if (board_ref_freq_mutex != NULL) {
+		acc_os_mutex_lock(board_ref_freq_mutex);
+	}
 
-	return ACC_STATUS_UNSUPPORTED;
+	bool stored = store_ref_freq(ref_freq);
+
+	if (board_ref_freq_mutex != NULL) {
+		acc_os_mutex_unlock(board_ref_freq_mutex);
+	}
+
+	return stored ? ACC_STATUS_SUCCESS : ACC_STATUS_BAD_PARAM;
 }
@@ -0,0 +1,391 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "acc_board_temperature.h"
+#include "acc_device_i2c.h"
+#include "acc_driver_i2c_linux.h"
+#include "acc_log.h"
+#include "acc_os.h"
+#include "acc_os_linux.h"
+#include "acc_types.h"
+
+
+/**
+ * @brief The module name
+ */
+#define MODULE "board_temperature"
+
+#define TEMPERATURE_DEVICE_ID		(0x48)		/**< @brief I2C device ID of the LM75 compatible temperature sensor */
+#define TEMPERATURE_REGISTER		(0x00)		/**< @brief Temperature register, 1/256 °C big endian */
+#define THERMAL_ZONE_PATH		"/sys/class/thermal/thermal_zone0/temp"
+
+/**
+ * @brief Number of sensors that drift is tracked for
+ */
+#define SENSOR_COUNT_MAX		(32)
+
+
+/**
+ * @brief Where the temperature is read from
+ */
+typedef enum {
+	SOURCE_NONE,
+	SOURCE_I2C,
+	SOURCE_THERMAL_ZONE
+} source_t;
+
+
+/**
+ * @brief Mutex to protect starting and stopping of the monitor
+ */
+static pthread_mutex_t		monitor_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static acc_os_thread_handle_t	monitor_thread = NULL;
+static acc_os_semaphore_t	monitor_stop_semaphore = NULL;
+static source_t			monitor_source = SOURCE_NONE;
+static uint_fast16_t		monitor_period_ms;
+
+/**
+ * @brief The latest temperature [°C], read without locking
+ */
+static int16_t			temperature = ACC_BOARD_TEMPERATURE_UNKNOWN;
+
+/**
+ * @brief Drift threshold [°C], read without locking
+ */
+static uint8_t			drift_threshold = ACC_BOARD_TEMPERATURE_DRIFT_THRESHOLD;
+
+/**
+ * @brief Temperature at calibration of each sensor, valid if the bit of the sensor is set in calibrated_mask
+ */
+static int16_t			calibration_temperature[SENSOR_COUNT_MAX];
+static uint32_t			calibrated_mask = 0;
+
+/**
+ * @brief Sensors whose temperature has drifted past the threshold since calibration
+ */
+static uint32_t			recalibration_mask = 0;
+
+/**
+ * @brief Buffer of the queued I2C reading, and true while the reading is queued
+ */
+static uint8_t			i2c_buffer[2];
+static bool			i2c_read_pending = false;
+
+
+static uint32_t sensor_bit(acc_sensor_t sensor)
+{
+	return 1u << ((sensor - 1) % SENSOR_COUNT_MAX);
+}
+
+
+static void publish(int_fast16_t value);
+
+
+/**
+ * @brief Convert the temperature register of the I2C temperature sensor
+ *
+ * @param[in] buffer The register
+ * @return The temperature [°C]
+ */
+static int_fast16_t convert_i2c(const uint8_t *buffer)
+{
+	int_fast32_t raw = (int16_t)(((uint16_t)buffer[0] << 8) | buffer[1]);
+
+	return (raw + (raw >= 0 ? 128 : -128)) / 256;
+}
+
+
+/**
+ * @brief Store the status of a queued I2C reading that is waited for
+ */
+static void read_i2c_done(acc_status_t status, void *user_data)
+{
+	*(acc_status_t *)user_data = status;
+}
+
+
+/**
+ * @brief Read the temperature from the I2C temperature sensor, waiting for the reading
+ *
+ * @param[out] value The temperature [°C]
+ * @return True if the temperature was read
+ */
+static bool read_i2c(int_fast16_t *value)
+{
+	uint8_t		buffer[2];
+	acc_status_t	status = ACC_STATUS_FAILURE;
+
+	if (acc_driver_i2c_linux_read_async(TEMPERATURE_DEVICE_ID, TEMPERATURE_REGISTER, 1, buffer, sizeof(buffer),
+	                                    read_i2c_done, &status) != ACC_STATUS_SUCCESS) {
+		return false;
+	}
+
+	acc_driver_i2c_linux_drain();
+
+	if (status != ACC_STATUS_SUCCESS) {
+		return false;
+	}
+
+	*value = convert_i2c(buffer);
+
+	return true;
+}
+
+
+/**
+ * @brief Publish a queued I2C reading, called from the I2C worker thread
+ */
+static void queued_read_i2c_done(acc_status_t status, void *user_data)
+{
+	(void)user_data;
+
+	if (status == ACC_STATUS_SUCCESS) {
+		publish(convert_i2c(i2c_buffer));
+	}
+
+	__atomic_store_n(&i2c_read_pending, false, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief Queue a reading of the I2C temperature sensor, the temperature is published when it is done
+ *
+ * Nothing is queued while the previous reading is still queued.
+ */
+static void queue_read_i2c(void)
+{
+	if (__atomic_exchange_n(&i2c_read_pending, true, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	if (acc_driver_i2c_linux_read_async(TEMPERATURE_DEVICE_ID, TEMPERATURE_REGISTER, 1, i2c_buffer, sizeof(i2c_buffer),
+	                                    queued_read_i2c_done, NULL) != ACC_STATUS_SUCCESS) {
+		__atomic_store_n(&i2c_read_pending, false, __ATOMIC_RELEASE);
+	}
+}
+
+
+/**
+ * @brief Read the temperature of the SoC thermal zone
+ *
+ * @param[out] value The temperature [°C]
+ * @return True if the temperature was read
+ */
+static bool read_thermal_zone(int_fast16_t *value)
+{
+	FILE	*file = fopen(THERMAL_ZONE_PATH, "r");
+	long	millidegrees;
+
+	if (file == NULL) {
+		return false;
+	}
+
+	int items = fscanf(file, "%ld", &millidegrees);
+	fclose(file);
+
+	if (items != 1) {
+		return false;
+	}
+
+	*value = (millidegrees + (millidegrees >= 0 ? 500 : -500)) / 1000;
+
+	return true;
+}
+
+
+/**
+ * @brief Read the temperature from a source
+ *
+ * @param[in] source The source
+ * @param[out] value The temperature [°C]
+ * @return True if the temperature was read
+ */
+static bool read_source(source_t source, int_fast16_t *value)
+{
+	switch (source) {
+		case SOURCE_I2C:
+			return read_i2c(value);
+		case SOURCE_THERMAL_ZONE:
+			return read_thermal_zone(value);
+		default:
+			return false;
+	}
+}
+
+
+/**
+ * @brief Find a temperature source and make a first reading
+ *
+ * @param[out] value The temperature [°C]
+ * @return The source, SOURCE_NONE if there is none
+ */
+static source_t probe_source(int_fast16_t *value)
+{
+	if ((acc_device_i2c_init() == ACC_STATUS_SUCCESS) && read_i2c(value)) {
+		ACC_LOG_VERBOSE("Board temperature read from I2C device 0x%02x", (unsigned int)TEMPERATURE_DEVICE_ID);
+		return SOURCE_I2C;
+	}
+
+	if (read_thermal_zone(value)) {
+		ACC_LOG_VERBOSE("Board temperature read from %s", THERMAL_ZONE_PATH);
+		return SOURCE_THERMAL_ZONE;
+	}
+
+	return SOURCE_NONE;
+}
+
+
+/**
+ * @brief Publish a temperature and flag the sensors that have drifted too far since calibration
+ *
+ * @param[in] value The temperature [°C]
+ */
+static void publish(int_fast16_t value)
+{
+	__atomic_store_n(&temperature, (int16_t)value, __ATOMIC_RELEASE);
+
+	uint32_t	calibrated = __atomic_load_n(&calibrated_mask, __ATOMIC_ACQUIRE);
+	int_fast16_t	threshold = __atomic_load_n(&drift_threshold, __ATOMIC_RELAXED);
+
+	for (uint_fast8_t index = 0; index < SENSOR_COUNT_MAX; index++) {
+		uint32_t bit = 1u << index;
+
+		if ((calibrated & bit) == 0) {
+			continue;
+		}
+
+		int_fast16_t drift = value - __atomic_load_n(&calibration_temperature[index], __ATOMIC_RELAXED);
+
+		if ((drift >= threshold || drift <= -threshold) &&
+		    (__atomic_fetch_or(&recalibration_mask, bit, __ATOMIC_RELEASE) & bit) == 0) {
+			ACC_LOG_INFO("Temperature of sensor %u has drifted %d C since calibration", (unsigned int)(index + 1), (int)drift);
+		}
+	}
+}
+
+
+/**
+ * @brief The monitor thread, reads the temperature until stopped
+ *
+ * I2C readings are queued to the I2C worker thread, so the monitor never waits for the bus.
+ *
+ * @param param Not used
+ */
+static void monitor_thread_func(void *param)
+{
+	(void)param;
+
+	int_fast16_t value;
+
+	while (acc_os_semaphore_wait(monitor_stop_semaphore, monitor_period_ms) != 0) {
+		if (monitor_source == SOURCE_I2C) {
+			queue_read_i2c();
+		} else if (read_source(monitor_source, &value)) {
+			publish(value);
+		}
+	}
+}
+
+
+acc_status_t acc_board_temperature_monitor_start(uint_fast16_t period_ms, uint_fast8_t threshold)
+{
+	int_fast16_t value;
+
+	pthread_mutex_lock(&monitor_mutex);
+
+	if (monitor_thread != NULL) {
+		pthread_mutex_unlock(&monitor_mutex);
+		return ACC_STATUS_SUCCESS;
+	}
+
+	__atomic_store_n(&drift_threshold, (uint8_t)threshold, __ATOMIC_RELAXED);
+
+	monitor_source = probe_source(&value);
+	if (monitor_source == SOURCE_NONE) {
+		ACC_LOG_WARNING("No board temperature source available");
+		pthread_mutex_unlock(&monitor_mutex);
+		return ACC_STATUS_FAILURE;
+	}
+
+	publish(value);
+
+	monitor_period_ms	= period_ms;
+	monitor_stop_semaphore	= acc_os_semaphore_create();
+	if (monitor_stop_semaphore == NULL) {
+		pthread_mutex_unlock(&monitor_mutex);
+		return ACC_STATUS_FAILURE;
+	}
+
+	// Not a radar thread, so the attributes set for acc_os_thread_create() are not used
+	acc_driver_os_linux_thread_attributes_t attributes = ACC_DRIVER_OS_LINUX_THREAD_ATTRIBUTES_DEFAULT;
+	acc_driver_os_linux_thread_attributes_t radar_attributes;
+
+	acc_driver_os_linux_get_thread_attributes(&radar_attributes);
+	attributes.name			= "acc_temperature";
+	attributes.stack_tracking	= radar_attributes.stack_tracking;
+
+	monitor_thread = acc_driver_os_linux_thread_create_ex(monitor_thread_func, NULL, &attributes);
+	if (monitor_thread == NULL) {
+		ACC_LOG_ERROR("Unable to create board temperature thread");
+		acc_os_semaphore_destroy(monitor_stop_semaphore);
+		monitor_stop_semaphore = NULL;
+		pthread_mutex_unlock(&monitor_mutex);
+		return ACC_STATUS_FAILURE;
+	}
+
+	pthread_mutex_unlock(&monitor_mutex);
+
+	return ACC_STATUS_SUCCESS;
+}
+
+
+void acc_board_temperature_monitor_stop(void)
+{
+	pthread_mutex_lock(&monitor_mutex);
+
+	if (monitor_thread != NULL) {
+		acc_os_semaphore_signal(monitor_stop_semaphore);
+		acc_os_thread_cleanup(monitor_thread);
+		acc_os_semaphore_destroy(monitor_stop_semaphore);
+
+		// No reading is published after the monitor has stopped
+		acc_driver_i2c_linux_drain();
+		monitor_thread		= NULL;
+		monitor_stop_semaphore	= NULL;
+	}
+
+	pthread_mutex_unlock(&monitor_mutex);
+}
+
+
+int_fast16_t acc_board_temperature_get(void)
+{
+	return __atomic_load_n(&temperature, __ATOMIC_ACQUIRE);
+}
+
+
+void acc_board_temperature_set_calibrated(acc_sensor_t sensor, int_fast16_t value)
+{
+	uint32_t bit = sensor_bit(sensor);
+
+	if (value == ACC_BOARD_TEMPERATURE_UNKNOWN) {
+		__atomic_fetch_and(&calibrated_mask, ~bit, __ATOMIC_RELEASE);
+	} else {
+		__atomic_store_n(&calibration_temperature[(sensor - 1) % SENSOR_COUNT_MAX], (int16_t)value, __ATOMIC_RELAXED);
+		__atomic_fetch_or(&calibrated_mask, bit, __ATOMIC_RELEASE);
+	}
+
+	__atomic_fetch_and(&recalibration_mask, ~bit, __ATOMIC_RELEASE);
+}
+
+
+bool acc_board_temperature_recalibration_needed(acc_sensor_t sensor)
+{
+	return (__atomic_load_n(&recalibration_mask, __ATOMIC_ACQUIRE) & sensor_bit(sensor)) != 0;
+}
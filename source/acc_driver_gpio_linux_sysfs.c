@@ -15,6 +15,7 @@
 #include "acc_device_gpio.h"
 #include "acc_log.h"
 #include "acc_os.h"
+#include "acc_os_linux.h"
 #include "acc_types.h"
 
 
@@ -23,6 +24,11 @@
  */
 #define MODULE		"driver_gpio_linux_sysfs"
 
+/**
+ * @brief Stack size of the interrupt threads, which only poll and call the registered ISR
+ */
+#define GPIO_ISR_THREAD_STACK_SIZE	(64 * 1024)
+
 /**
  * @brief Paths to the GPIO sysfs files
  */
@@ -546,7 +552,14 @@ static bool register_isr(uint_fast8_t pin, acc_gpio_edge_t edge, acc_device_gpio
 		return false;
 	}
 
-	gpio->handle = acc_os_thread_create(&wait_for_interrupts, gpio);
+	// Same attributes as the other radar threads, with a smaller stack
+	acc_driver_os_linux_thread_attributes_t attributes;
+
+	acc_driver_os_linux_get_thread_attributes(&attributes);
+	attributes.stack_size	= GPIO_ISR_THREAD_STACK_SIZE;
+	attributes.name		= "acc_gpio_isr";
+
+	gpio->handle = acc_driver_os_linux_thread_create_ex(&wait_for_interrupts, gpio, &attributes);
 	if (gpio->handle == NULL)
 	{
 		ACC_LOG_ERROR("Failed to initiate interrupt handler.");
@@ -831,6 +844,24 @@ static acc_status_t acc_driver_gpio_linux_sysfs_register_isr(uint_fast8_t pin, a
 }
 
 
+int acc_driver_gpio_linux_sysfs_get_output_fd(uint_fast8_t pin)
+{
+	if ((gpios == NULL) || (pin >= gpio_count))
+	{
+		return -1;
+	}
+
+	gpio_t *gpio = &gpios[pin];
+
+	if (!gpio->is_open || (gpio->dir != GPIO_DIR_OUT))
+	{
+		return -1;
+	}
+
+	return gpio->value_fd;
+}
+
+
 /**
  * @brief Request driver to register with appropriate device(s)
  *
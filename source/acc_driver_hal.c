@@ -10,11 +10,73 @@
 #include "acc_definitions.h"
 #include "acc_device_spi.h"
 #include "acc_log.h"
+#include "acc_os_linux.h"
+#include "acc_rss.h"
 #include "acc_types.h"
 
 
 #define MODULE "driver_hal"
 
+#define SENSOR_COUNT_MAX	(32)	/**< @brief The highest sensor id handled by the HAL */
+
+#define TIMING_SENSOR_COUNT_MAX	(8)	/**< @brief The highest sensor id with transfer timing */
+#define TIMING_SUB_BUCKETS	(4)	/**< @brief Histogram buckets per power of two */
+#define TIMING_BUCKET_COUNT	(124)	/**< @brief Histogram buckets covering 0 to UINT32_MAX ns */
+
+
+
+/**
+ * @brief Accumulated timing of one transfer phase of one sensor, all members are only accessed atomically
+ */
+typedef struct {
+	uint32_t	count;
+	uint64_t	sum_ns;
+	uint32_t	min_ns_inverted;	/**< Bitwise inverse of the minimum, so that zero means no sample */
+	uint32_t	max_ns;
+	uint32_t	buckets[TIMING_BUCKET_COUNT];
+} phase_timing_t;
+
+
+/**
+ * @brief Sensors with a detected fault, bit (sensor_id - 1) is set for a faulty sensor
+ */
+static uint32_t sensor_fault_mask = 0;
+
+/**
+ * @brief When the interrupt of each sensor was first seen active with no transfer since [ns], 0 if not active
+ */
+static uint64_t interrupt_active_since_ns[SENSOR_COUNT_MAX];
+
+/**
+ * @brief Time an interrupt may stay active without a transfer before the sensor is faulty [ms], 0 to not check
+ */
+static uint32_t interrupt_timeout_ms = 0;
+
+/**
+ * @brief Sensors with transfer batching enabled, bit (sensor_id - 1) is set when enabled
+ */
+static uint32_t sensor_batching_mask = 0;
+
+/**
+ * @brief Transfers prepared when each sensor was powered on, NULL if not prepared
+ */
+static acc_board_sensor_transfer_t prepared_transfers[SENSOR_COUNT_MAX];
+
+/**
+ * @brief True if transfers are prepared when a sensor is powered on, only accessed atomically
+ */
+static bool prepared_transfers_enabled = true;
+
+/**
+ * @brief True if transfers are timed, only accessed atomically
+ */
+static bool transfer_timing_enabled = false;
+
+/**
+ * @brief Timing of each transfer phase for each sensor
+ */
+static phase_timing_t transfer_timing[TIMING_SENSOR_COUNT_MAX][ACC_BOARD_TRANSFER_PHASE_COUNT];
+
 //-----------------------------
 // Private declarations
 //-----------------------------
@@ -22,7 +84,16 @@
 static bool sensor_power_on(acc_sensor_id_t sensor_id);
 static bool sensor_power_off(acc_sensor_id_t sensor_id);
 static acc_hal_register_isr_status_t sensor_register_isr(acc_hal_sensor_isr_t isr);
+static bool sensor_is_interrupt_active(acc_sensor_id_t sensor_id);
+static bool interrupt_observe(acc_sensor_id_t sensor_id, bool active);
 static bool sensor_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_size);
+static uint32_t sensor_bit(acc_sensor_id_t sensor_id);
+static bool generic_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_size, uint64_t *phase_end_ns);
+static void phase_mark(uint64_t *phase_end_ns, acc_board_transfer_phase_t phase);
+static void timing_record(acc_sensor_id_t sensor_id, uint64_t start_ns, const uint64_t *phase_end_ns);
+static uint_fast8_t timing_bucket(uint32_t duration_ns);
+static uint32_t timing_bucket_upper_ns(uint_fast8_t bucket);
+static void atomic_max_u32(uint32_t *target, uint32_t value);
 
 //-----------------------------
 // Public definitions
@@ -54,7 +125,7 @@ acc_hal_t acc_driver_hal_get_implementation(void)
 	hal.sensor_device.power_on = sensor_power_on;
 	hal.sensor_device.power_off = sensor_power_off;
 	hal.sensor_device.is_interrupt_connected = acc_board_is_sensor_interrupt_connected;
-	hal.sensor_device.is_interrupt_active = acc_board_is_sensor_interrupt_active;
+	hal.sensor_device.is_interrupt_active = sensor_is_interrupt_active;
 	hal.sensor_device.register_isr = sensor_register_isr;
 	hal.sensor_device.transfer = sensor_transfer;
 	hal.sensor_device.get_reference_frequency = acc_board_get_ref_freq;
@@ -63,18 +134,229 @@ acc_hal_t acc_driver_hal_get_implementation(void)
 }
 
 
+bool acc_driver_hal_sensor_has_fault(acc_sensor_id_t sensor_id)
+{
+	if ((__atomic_load_n(&sensor_fault_mask, __ATOMIC_ACQUIRE) & sensor_bit(sensor_id)) != 0) {
+		return true;
+	}
+
+	if ((sensor_id == 0) || (sensor_id > SENSOR_COUNT_MAX) || (__atomic_load_n(&interrupt_timeout_ms, __ATOMIC_RELAXED) == 0) ||
+	    !acc_board_is_sensor_interrupt_connected(sensor_id)) {
+		return false;
+	}
+
+	if (interrupt_observe(sensor_id, acc_board_is_sensor_interrupt_active(sensor_id))) {
+		ACC_LOG_WARNING("Interrupt of sensor %" PRIsensor " is stuck active", sensor_id);
+		acc_driver_hal_report_sensor_fault(sensor_id);
+		return true;
+	}
+
+	return false;
+}
+
+
+void acc_driver_hal_set_interrupt_timeout(uint32_t timeout_ms)
+{
+	__atomic_store_n(&interrupt_timeout_ms, timeout_ms, __ATOMIC_RELAXED);
+}
+
+
+void acc_driver_hal_report_sensor_fault(acc_sensor_id_t sensor_id)
+{
+	uint32_t bit = sensor_bit(sensor_id);
+
+	if (bit == 0) {
+		return;
+	}
+
+	uint32_t previous = __atomic_fetch_or(&sensor_fault_mask, bit, __ATOMIC_ACQ_REL);
+
+	if ((previous & bit) == 0) {
+		ACC_LOG_WARNING("Fault detected on sensor %" PRIsensor, sensor_id);
+	}
+}
+
+
+void acc_driver_hal_set_transfer_batching(acc_sensor_id_t sensor_id, bool batching)
+{
+	if ((sensor_id == 0) || (sensor_id > SENSOR_COUNT_MAX)) {
+		return;
+	}
+
+	if (batching) {
+		__atomic_fetch_or(&sensor_batching_mask, sensor_bit(sensor_id), __ATOMIC_ACQ_REL);
+	} else {
+		__atomic_fetch_and(&sensor_batching_mask, ~sensor_bit(sensor_id), __ATOMIC_ACQ_REL);
+	}
+
+	acc_board_sensor_transfer_t transfer = __atomic_load_n(&prepared_transfers[sensor_id - 1], __ATOMIC_ACQUIRE);
+
+	if (transfer != NULL) {
+		acc_board_set_sensor_transfer_batching(transfer, batching);
+	}
+}
+
+
+void acc_driver_hal_set_prepared_transfers(bool enable)
+{
+	__atomic_store_n(&prepared_transfers_enabled, enable, __ATOMIC_RELEASE);
+}
+
+
+void acc_driver_hal_set_transfer_timing(bool enable)
+{
+	__atomic_store_n(&transfer_timing_enabled, enable, __ATOMIC_RELEASE);
+}
+
+
+bool acc_driver_hal_get_transfer_timing(acc_sensor_id_t sensor_id, acc_board_transfer_phase_t phase, acc_driver_hal_transfer_timing_t *timing)
+{
+	if ((sensor_id == 0) || (sensor_id > TIMING_SENSOR_COUNT_MAX) || (phase >= ACC_BOARD_TRANSFER_PHASE_COUNT)) {
+		return false;
+	}
+
+	phase_timing_t	*phase_timing = &transfer_timing[sensor_id - 1][phase];
+	uint32_t	buckets[TIMING_BUCKET_COUNT];
+	uint32_t	bucket_count = 0;
+
+	timing->count	= __atomic_load_n(&phase_timing->count, __ATOMIC_ACQUIRE);
+	timing->sum_ns	= __atomic_load_n(&phase_timing->sum_ns, __ATOMIC_RELAXED);
+	timing->min_ns	= ~__atomic_load_n(&phase_timing->min_ns_inverted, __ATOMIC_RELAXED);
+	timing->max_ns	= __atomic_load_n(&phase_timing->max_ns, __ATOMIC_RELAXED);
+	timing->p99_ns	= 0;
+
+	if (timing->count == 0) {
+		timing->min_ns = 0;
+		return true;
+	}
+
+	for (uint_fast8_t bucket = 0; bucket < TIMING_BUCKET_COUNT; bucket++) {
+		buckets[bucket] = __atomic_load_n(&phase_timing->buckets[bucket], __ATOMIC_RELAXED);
+		bucket_count += buckets[bucket];
+	}
+
+	// The histogram may be updated while it is read, so the percentile is based on its own total
+	uint32_t rank = bucket_count - (bucket_count / 100);
+	uint32_t accumulated = 0;
+
+	for (uint_fast8_t bucket = 0; bucket < TIMING_BUCKET_COUNT; bucket++) {
+		accumulated += buckets[bucket];
+		if ((accumulated >= rank) && (accumulated > 0)) {
+			uint32_t upper_ns = timing_bucket_upper_ns(bucket);
+
+			timing->p99_ns = (upper_ns < timing->max_ns) ? upper_ns : timing->max_ns;
+			break;
+		}
+	}
+
+	return true;
+}
+
+
+void acc_driver_hal_reset_transfer_timing(void)
+{
+	for (uint_fast8_t sensor = 0; sensor < TIMING_SENSOR_COUNT_MAX; sensor++) {
+		for (uint_fast8_t phase = 0; phase < ACC_BOARD_TRANSFER_PHASE_COUNT; phase++) {
+			phase_timing_t *phase_timing = &transfer_timing[sensor][phase];
+
+			__atomic_store_n(&phase_timing->count, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&phase_timing->sum_ns, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&phase_timing->min_ns_inverted, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&phase_timing->max_ns, 0, __ATOMIC_RELAXED);
+			for (uint_fast8_t bucket = 0; bucket < TIMING_BUCKET_COUNT; bucket++) {
+				__atomic_store_n(&phase_timing->buckets[bucket], 0, __ATOMIC_RELAXED);
+			}
+		}
+	}
+
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+bool acc_driver_hal_recover_sensor(acc_sensor_id_t sensor_id)
+{
+	acc_status_t	status;
+	bool		started = acc_board_is_sensor_started(sensor_id);
+
+	// A sensor stopped by its service is started for the reset, so that its ENABLE line is cycled
+	// and its interrupt is checked with the sensor powered
+	if (!started) {
+		status = acc_board_start_sensor(sensor_id);
+		if (status != ACC_STATUS_SUCCESS) {
+			ACC_LOG_ERROR("Unable to start sensor %" PRIsensor ": %s", sensor_id, acc_log_status_name(status));
+			return false;
+		}
+	}
+
+	status = acc_board_reset_sensor(sensor_id);
+
+	bool interrupt_active = (status == ACC_STATUS_SUCCESS) && acc_board_is_sensor_interrupt_connected(sensor_id) &&
+	                        acc_board_is_sensor_interrupt_active(sensor_id);
+
+	if (!started) {
+		acc_board_stop_sensor(sensor_id);
+	}
+
+	if (status != ACC_STATUS_SUCCESS) {
+		ACC_LOG_ERROR("Unable to reset sensor %" PRIsensor ": %s", sensor_id, acc_log_status_name(status));
+		return false;
+	}
+
+	if (interrupt_active) {
+		ACC_LOG_ERROR("Interrupt of sensor %" PRIsensor " is still active after reset", sensor_id);
+		return false;
+	}
+
+	// The sensor has lost its calibration, unless RSS refuses since a service is active on another sensor
+	if (!acc_rss_calibration_reset(sensor_id)) {
+		ACC_LOG_WARNING("Calibration of sensor %" PRIsensor " could not be reset, existing calibration is reused", sensor_id);
+	}
+
+	if ((sensor_id > 0) && (sensor_id <= SENSOR_COUNT_MAX)) {
+		__atomic_store_n(&interrupt_active_since_ns[sensor_id - 1], 0, __ATOMIC_RELAXED);
+	}
+	__atomic_fetch_and(&sensor_fault_mask, ~sensor_bit(sensor_id), __ATOMIC_ACQ_REL);
+
+	ACC_LOG_INFO("Sensor %" PRIsensor " recovered", sensor_id);
+
+	return true;
+}
+
+
 //-----------------------------
 // Private definitions
 //-----------------------------
 
 bool sensor_power_on(acc_sensor_id_t sensor_id)
 {
-	return acc_board_start_sensor(sensor_id) == ACC_STATUS_SUCCESS;
+	if (acc_board_start_sensor(sensor_id) != ACC_STATUS_SUCCESS) {
+		return false;
+	}
+
+	if ((sensor_id > 0) && (sensor_id <= SENSOR_COUNT_MAX)) {
+		acc_board_sensor_transfer_t transfer = NULL;
+
+		if (__atomic_load_n(&prepared_transfers_enabled, __ATOMIC_ACQUIRE)) {
+			transfer = acc_board_prepare_sensor_transfer(sensor_id);
+		}
+
+		if ((transfer != NULL) && ((__atomic_load_n(&sensor_batching_mask, __ATOMIC_ACQUIRE) & sensor_bit(sensor_id)) != 0)) {
+			acc_board_set_sensor_transfer_batching(transfer, true);
+		}
+
+		__atomic_store_n(&prepared_transfers[sensor_id - 1], transfer, __ATOMIC_RELEASE);
+	}
+
+	return true;
 }
 
 
 bool sensor_power_off(acc_sensor_id_t sensor_id)
 {
+	if ((sensor_id > 0) && (sensor_id <= SENSOR_COUNT_MAX)) {
+		__atomic_store_n(&prepared_transfers[sensor_id - 1], NULL, __ATOMIC_RELEASE);
+	}
+
 	return acc_board_stop_sensor(sensor_id) == ACC_STATUS_SUCCESS;
 }
 
@@ -98,7 +380,95 @@ acc_hal_register_isr_status_t sensor_register_isr(acc_hal_sensor_isr_t isr)
 }
 
 
+bool sensor_is_interrupt_active(acc_sensor_id_t sensor_id)
+{
+	bool active = acc_board_is_sensor_interrupt_active(sensor_id);
+
+	if ((sensor_id > 0) && (sensor_id <= SENSOR_COUNT_MAX)) {
+		interrupt_observe(sensor_id, active);
+	}
+
+	return active;
+}
+
+
+/**
+ * @brief Track how long the interrupt of a sensor has been active without a transfer
+ *
+ * @param[in] sensor_id The sensor, at most SENSOR_COUNT_MAX
+ * @param[in] active True if the interrupt was just seen active
+ * @return True if the interrupt has been active without a transfer for longer than the interrupt timeout
+ */
+bool interrupt_observe(acc_sensor_id_t sensor_id, bool active)
+{
+	uint64_t *since_ns = &interrupt_active_since_ns[sensor_id - 1];
+
+	if (!active) {
+		__atomic_store_n(since_ns, 0, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	uint64_t now_ns = acc_driver_os_linux_time_ns();
+	uint64_t expected_ns = 0;
+
+	// Only the first observation of an active interrupt starts the timeout, a transfer restarts it
+	if (__atomic_compare_exchange_n(since_ns, &expected_ns, now_ns, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		return false;
+	}
+
+	uint32_t timeout_ms = __atomic_load_n(&interrupt_timeout_ms, __ATOMIC_RELAXED);
+
+	return (timeout_ms != 0) && (now_ns - expected_ns > (uint64_t)timeout_ms * 1000000);
+}
+
+
 bool sensor_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_size)
+{
+	uint64_t			phase_end_ns[ACC_BOARD_TRANSFER_PHASE_COUNT];
+	uint64_t			*timing = NULL;
+	uint64_t			start_ns = 0;
+	acc_board_sensor_transfer_t	transfer = NULL;
+	bool				success;
+
+	if ((sensor_id > 0) && (sensor_id <= TIMING_SENSOR_COUNT_MAX) && __atomic_load_n(&transfer_timing_enabled, __ATOMIC_RELAXED)) {
+		timing = phase_end_ns;
+		start_ns = acc_driver_os_linux_time_ns();
+	}
+
+	if ((sensor_id > 0) && (sensor_id <= SENSOR_COUNT_MAX)) {
+		transfer = __atomic_load_n(&prepared_transfers[sensor_id - 1], __ATOMIC_ACQUIRE);
+
+		// The sensor is serviced, so an active interrupt is not stuck
+		__atomic_store_n(&interrupt_active_since_ns[sensor_id - 1], 0, __ATOMIC_RELAXED);
+	}
+
+	if (transfer != NULL) {
+		success = acc_board_sensor_transfer(transfer, buffer, buffer_size, timing) == ACC_STATUS_SUCCESS;
+		if (!success) {
+			acc_driver_hal_report_sensor_fault(sensor_id);
+		}
+	} else {
+		success = generic_transfer(sensor_id, buffer, buffer_size, timing);
+	}
+
+	if (success && (timing != NULL)) {
+		timing_record(sensor_id, start_ns, timing);
+	}
+
+	return success;
+}
+
+
+/**
+ * @brief Transfer to a sensor without a prepared transfer
+ *
+ * @param[in] sensor_id The sensor to transfer to
+ * @param[in,out] buffer The data to be transferred
+ * @param[in] buffer_size The size of the buffer in bytes
+ * @param[out] phase_end_ns The time [ns] at which each phase ended is returned here, or NULL
+ * @return True if successful
+ */
+bool generic_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_size, uint64_t *phase_end_ns)
 {
 	acc_status_t status;
 	uint_fast8_t spi_bus;
@@ -109,30 +479,157 @@ bool sensor_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_s
 	spi_speed = acc_board_get_spi_speed(spi_bus);
 
 	acc_device_spi_lock(spi_bus);
+	phase_mark(phase_end_ns, ACC_BOARD_TRANSFER_PHASE_LOCK);
 
 	status = acc_board_chip_select(sensor_id, 1);
 
 	if (status != ACC_STATUS_SUCCESS) {
 		ACC_LOG_ERROR("%s failed with %s", __func__, acc_log_status_name(status));
 		acc_device_spi_unlock(spi_bus);
+		acc_driver_hal_report_sensor_fault(sensor_id);
 		return false;
 	}
+	phase_mark(phase_end_ns, ACC_BOARD_TRANSFER_PHASE_CHIP_SELECT);
 
 	status = acc_device_spi_transfer(spi_bus, spi_device, spi_speed, buffer, buffer_size);
 
 	if (status != ACC_STATUS_SUCCESS) {
+		acc_board_chip_select(sensor_id, 0);
 		acc_device_spi_unlock(spi_bus);
+		acc_driver_hal_report_sensor_fault(sensor_id);
 		return false;
 	}
+	phase_mark(phase_end_ns, ACC_BOARD_TRANSFER_PHASE_SPI);
 
 	status = acc_board_chip_select(sensor_id, 0);
 
 	if (status != ACC_STATUS_SUCCESS) {
 		acc_device_spi_unlock(spi_bus);
+		acc_driver_hal_report_sensor_fault(sensor_id);
 		return false;
 	}
 
 	acc_device_spi_unlock(spi_bus);
+	phase_mark(phase_end_ns, ACC_BOARD_TRANSFER_PHASE_DESELECT);
 
 	return true;
 }
+
+
+/**
+ * @brief Note the time at which a transfer phase ended
+ *
+ * @param[out] phase_end_ns Phase end times [ns], nothing is done if NULL
+ * @param[in] phase The phase that ended
+ */
+void phase_mark(uint64_t *phase_end_ns, acc_board_transfer_phase_t phase)
+{
+	if (phase_end_ns != NULL) {
+		phase_end_ns[phase] = acc_driver_os_linux_time_ns();
+	}
+}
+
+
+/**
+ * @brief Add the phase durations of one transfer to the accumulated timing of a sensor
+ *
+ * Each phase starts when the previous phase ended, the first phase when the transfer started.
+ *
+ * @param[in] sensor_id The sensor, at most TIMING_SENSOR_COUNT_MAX
+ * @param[in] start_ns The time [ns] at which the transfer started
+ * @param[in] phase_end_ns The time [ns] at which each phase ended
+ */
+void timing_record(acc_sensor_id_t sensor_id, uint64_t start_ns, const uint64_t *phase_end_ns)
+{
+	uint32_t phase_ns[ACC_BOARD_TRANSFER_PHASE_COUNT];
+
+	for (uint_fast8_t phase = 0; phase < ACC_BOARD_TRANSFER_PHASE_COUNT; phase++) {
+		uint64_t elapsed_ns = phase_end_ns[phase] - start_ns;
+
+		phase_ns[phase]	= (elapsed_ns > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed_ns;
+		start_ns	= phase_end_ns[phase];
+	}
+
+	for (uint_fast8_t phase = 0; phase < ACC_BOARD_TRANSFER_PHASE_COUNT; phase++) {
+		phase_timing_t *phase_timing = &transfer_timing[sensor_id - 1][phase];
+
+		__atomic_fetch_add(&phase_timing->buckets[timing_bucket(phase_ns[phase])], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&phase_timing->sum_ns, phase_ns[phase], __ATOMIC_RELAXED);
+		atomic_max_u32(&phase_timing->min_ns_inverted, ~phase_ns[phase]);
+		atomic_max_u32(&phase_timing->max_ns, phase_ns[phase]);
+		__atomic_fetch_add(&phase_timing->count, 1, __ATOMIC_RELEASE);
+	}
+}
+
+
+/**
+ * @brief Get the histogram bucket of a duration
+ *
+ * Durations below 4 ns have one bucket each, above that each power of two is split in TIMING_SUB_BUCKETS buckets.
+ *
+ * @param[in] duration_ns The duration
+ * @return The bucket
+ */
+uint_fast8_t timing_bucket(uint32_t duration_ns)
+{
+	if (duration_ns < TIMING_SUB_BUCKETS) {
+		return duration_ns;
+	}
+
+	uint_fast8_t exponent = 31 - __builtin_clz(duration_ns);
+	uint_fast8_t sub_bucket = (duration_ns >> (exponent - 2)) & (TIMING_SUB_BUCKETS - 1);
+
+	return ((exponent - 1) * TIMING_SUB_BUCKETS) + sub_bucket;
+}
+
+
+/**
+ * @brief Get the largest duration that belongs to a histogram bucket
+ *
+ * @param[in] bucket The bucket
+ * @return The largest duration [ns] of the bucket
+ */
+uint32_t timing_bucket_upper_ns(uint_fast8_t bucket)
+{
+	if (bucket < TIMING_SUB_BUCKETS) {
+		return bucket;
+	}
+
+	uint_fast8_t	exponent = (bucket / TIMING_SUB_BUCKETS) + 1;
+	uint32_t	lower_ns = (uint32_t)(TIMING_SUB_BUCKETS + (bucket % TIMING_SUB_BUCKETS)) << (exponent - 2);
+
+	return lower_ns + ((uint32_t)1 << (exponent - 2)) - 1;
+}
+
+
+/**
+ * @brief Atomically raise a value to at least a given value
+ *
+ * @param[in,out] target The value to raise
+ * @param[in] value The new lower bound of the value
+ */
+void atomic_max_u32(uint32_t *target, uint32_t value)
+{
+	uint32_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+
+	while ((value > current) &&
+	       !__atomic_compare_exchange_n(target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		// current now holds the value stored by the other thread
+	}
+}
+
+
+/**
+ * @brief Get the bit of a sensor in the sensor masks
+ *
+ * @param[in] sensor_id The sensor
+ * @return Bit (sensor_id - 1), 0 if the sensor id is out of range
+ */
+uint32_t sensor_bit(acc_sensor_id_t sensor_id)
+{
+	if ((sensor_id == 0) || (sensor_id > SENSOR_COUNT_MAX)) {
+		return 0;
+	}
+
+	return 1u << (sensor_id - 1);
+}
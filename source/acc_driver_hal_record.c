@@ -0,0 +1,598 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "acc_driver_hal_record.h"
+
+#include "acc_definitions.h"
+#include "acc_log.h"
+#include "acc_os.h"
+#include "acc_os_linux.h"
+
+
+#define MODULE "driver_hal_record"
+
+#define RECORD_MAGIC		(0x52434341)	/**< @brief "ACCR" stored little endian */
+#define RECORD_VERSION		(2)
+#define RECORD_SENSOR_COUNT_MAX	(8)		/**< @brief Sensors with recorded interrupt connection */
+
+
+/**
+ * @brief Record types
+ */
+typedef enum {
+	RECORD_POWER_ON,		/**< Payload is the result */
+	RECORD_POWER_OFF,		/**< Payload is the result */
+	RECORD_INTERRUPT_ACTIVE,	/**< Payload is the result */
+	RECORD_TRANSFER,		/**< Payload is the transmitted data followed by the received data */
+	RECORD_TRANSFER_FAILED		/**< Payload is the transmitted data */
+} record_type_t;
+
+
+/**
+ * @brief Header of a recording, stored in native byte order
+ */
+typedef struct {
+	uint32_t	magic;
+	uint16_t	version;
+	uint8_t		sensor_count;
+	uint8_t		interrupt_connected_mask;	/**< Bit (sensor_id - 1) is set if the interrupt is connected */
+	uint32_t	max_spi_transfer_size;
+	float		ref_freq;
+} record_file_header_t;
+
+
+/**
+ * @brief Header of one record, followed by length bytes of payload
+ */
+typedef struct {
+	uint32_t	delta_us;	/**< Time since the previous record */
+	uint32_t	length;
+	uint8_t		type;
+	uint8_t		sensor;
+} record_header_t;
+
+
+/**
+ * @brief Mutex protecting the recording and the replay
+ */
+static pthread_mutex_t		record_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The recorded HAL, used to forward the calls when recording
+ */
+static acc_hal_t		recorded_hal;
+
+/**
+ * @brief The recording file, NULL if not recording
+ */
+static FILE			*record_file = NULL;
+
+/**
+ * @brief Copy of the data to transmit in the transfer being recorded, max_spi_transfer_size bytes
+ */
+static uint8_t			*record_tx_data = NULL;
+static size_t			record_tx_size;
+
+/**
+ * @brief Time of the previous record [us], when recording or replaying
+ */
+static uint64_t			previous_record_us;
+
+/**
+ * @brief The loaded recording, NULL if not replaying
+ */
+static uint8_t			*replay_data = NULL;
+static size_t			replay_size;
+static size_t			replay_position;
+static record_file_header_t	replay_file_header;
+static acc_driver_hal_replay_speed_t replay_speed;
+
+
+//-----------------------------
+// Private declarations
+//-----------------------------
+
+static bool record_power_on(acc_sensor_id_t sensor_id);
+static bool record_power_off(acc_sensor_id_t sensor_id);
+static bool record_is_interrupt_active(acc_sensor_id_t sensor_id);
+static acc_hal_register_isr_status_t record_register_isr(acc_hal_sensor_isr_t isr);
+static bool record_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_size);
+static void record_write(record_type_t type, acc_sensor_id_t sensor_id, const void *payload, size_t length);
+static void record_write_locked(record_type_t type, acc_sensor_id_t sensor_id, const void *payload, size_t length,
+                                const void *payload_tail, size_t tail_length);
+static bool replay_power_on(acc_sensor_id_t sensor_id);
+static bool replay_power_off(acc_sensor_id_t sensor_id);
+static bool replay_is_interrupt_connected(acc_sensor_id_t sensor_id);
+static bool replay_is_interrupt_active(acc_sensor_id_t sensor_id);
+static acc_hal_register_isr_status_t replay_register_isr(acc_hal_sensor_isr_t isr);
+static bool replay_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_size);
+static float replay_get_reference_frequency(void);
+static const uint8_t *replay_next(record_type_t type, acc_sensor_id_t sensor_id, size_t *length, bool *failed);
+static bool replay_result(record_type_t type, acc_sensor_id_t sensor_id);
+static uint64_t time_us(void);
+
+//-----------------------------
+// Public definitions
+//-----------------------------
+
+bool acc_driver_hal_record_start(acc_hal_t *hal, const char *path)
+{
+	record_file_header_t file_header = {
+		.magic				= RECORD_MAGIC,
+		.version			= RECORD_VERSION,
+		.sensor_count			= hal->properties.sensor_count,
+		.interrupt_connected_mask	= 0,
+		.max_spi_transfer_size		= hal->properties.max_spi_transfer_size,
+		.ref_freq			= hal->sensor_device.get_reference_frequency()
+	};
+
+	for (acc_sensor_id_t sensor_id = 1; (sensor_id <= hal->properties.sensor_count) && (sensor_id <= RECORD_SENSOR_COUNT_MAX); sensor_id++) {
+		if (hal->sensor_device.is_interrupt_connected(sensor_id)) {
+			file_header.interrupt_connected_mask |= 1 << (sensor_id - 1);
+		}
+	}
+
+	pthread_mutex_lock(&record_mutex);
+
+	if (record_file != NULL) {
+		ACC_LOG_ERROR("A recording is already in progress");
+		pthread_mutex_unlock(&record_mutex);
+		return false;
+	}
+
+	record_tx_size = hal->properties.max_spi_transfer_size;
+	record_tx_data = acc_os_mem_alloc(record_tx_size);
+	if (record_tx_data == NULL) {
+		ACC_LOG_ERROR("Out of memory");
+		pthread_mutex_unlock(&record_mutex);
+		return false;
+	}
+
+	record_file = fopen(path, "wb");
+	if (record_file == NULL) {
+		ACC_LOG_ERROR("Unable to create recording %s: %s", path, strerror(errno));
+		acc_os_mem_free(record_tx_data);
+		record_tx_data = NULL;
+		pthread_mutex_unlock(&record_mutex);
+		return false;
+	}
+
+	if (fwrite(&file_header, sizeof(file_header), 1, record_file) != 1) {
+		ACC_LOG_ERROR("Unable to write recording %s", path);
+		fclose(record_file);
+		record_file = NULL;
+		acc_os_mem_free(record_tx_data);
+		record_tx_data = NULL;
+		pthread_mutex_unlock(&record_mutex);
+		return false;
+	}
+
+	recorded_hal = *hal;
+	previous_record_us = time_us();
+
+	pthread_mutex_unlock(&record_mutex);
+
+	hal->sensor_device.power_on		= record_power_on;
+	hal->sensor_device.power_off		= record_power_off;
+	hal->sensor_device.is_interrupt_active	= record_is_interrupt_active;
+	hal->sensor_device.register_isr		= record_register_isr;
+	hal->sensor_device.transfer		= record_transfer;
+
+	return true;
+}
+
+
+void acc_driver_hal_record_stop(void)
+{
+	pthread_mutex_lock(&record_mutex);
+
+	if (record_file != NULL) {
+		if (fclose(record_file) != 0) {
+			ACC_LOG_ERROR("Unable to write recording: %s", strerror(errno));
+		}
+		record_file = NULL;
+	}
+
+	if (record_tx_data != NULL) {
+		acc_os_mem_free(record_tx_data);
+		record_tx_data = NULL;
+	}
+
+	pthread_mutex_unlock(&record_mutex);
+}
+
+
+bool acc_driver_hal_replay_open(const char *path, acc_driver_hal_replay_speed_t speed, acc_hal_t *hal)
+{
+	FILE *file = fopen(path, "rb");
+
+	if (file == NULL) {
+		ACC_LOG_ERROR("Unable to open recording %s: %s", path, strerror(errno));
+		return false;
+	}
+
+	pthread_mutex_lock(&record_mutex);
+
+	if (replay_data != NULL) {
+		ACC_LOG_ERROR("A recording is already being replayed");
+		pthread_mutex_unlock(&record_mutex);
+		fclose(file);
+		return false;
+	}
+
+	if ((fread(&replay_file_header, sizeof(replay_file_header), 1, file) != 1) || (replay_file_header.magic != RECORD_MAGIC)) {
+		ACC_LOG_ERROR("%s is not a recording", path);
+		pthread_mutex_unlock(&record_mutex);
+		fclose(file);
+		return false;
+	}
+
+	if (replay_file_header.version != RECORD_VERSION) {
+		ACC_LOG_ERROR("%s is a version %u recording, only version %u can be replayed", path,
+		              (unsigned int)replay_file_header.version, (unsigned int)RECORD_VERSION);
+		pthread_mutex_unlock(&record_mutex);
+		fclose(file);
+		return false;
+	}
+
+	long end = -1;
+
+	if (fseek(file, 0, SEEK_END) == 0) {
+		end = ftell(file);
+	}
+
+	if ((end < (long)sizeof(replay_file_header)) || (fseek(file, sizeof(replay_file_header), SEEK_SET) != 0)) {
+		ACC_LOG_ERROR("Unable to read recording %s", path);
+		pthread_mutex_unlock(&record_mutex);
+		fclose(file);
+		return false;
+	}
+
+	replay_size = end - sizeof(replay_file_header);
+	replay_data = acc_os_mem_alloc(replay_size + 1);
+	if (replay_data == NULL) {
+		ACC_LOG_ERROR("Out of memory");
+		pthread_mutex_unlock(&record_mutex);
+		fclose(file);
+		return false;
+	}
+
+	if (fread(replay_data, 1, replay_size, file) != replay_size) {
+		ACC_LOG_ERROR("Unable to read recording %s", path);
+		acc_os_mem_free(replay_data);
+		replay_data = NULL;
+		pthread_mutex_unlock(&record_mutex);
+		fclose(file);
+		return false;
+	}
+
+	fclose(file);
+
+	replay_position = 0;
+	replay_speed = speed;
+	previous_record_us = time_us();
+
+	pthread_mutex_unlock(&record_mutex);
+
+	hal->properties.sensor_count			= replay_file_header.sensor_count;
+	hal->properties.max_spi_transfer_size		= replay_file_header.max_spi_transfer_size;
+	hal->sensor_device.power_on			= replay_power_on;
+	hal->sensor_device.power_off			= replay_power_off;
+	hal->sensor_device.is_interrupt_connected	= replay_is_interrupt_connected;
+	hal->sensor_device.is_interrupt_active		= replay_is_interrupt_active;
+	hal->sensor_device.register_isr			= replay_register_isr;
+	hal->sensor_device.transfer			= replay_transfer;
+	hal->sensor_device.get_reference_frequency	= replay_get_reference_frequency;
+
+	return true;
+}
+
+
+void acc_driver_hal_replay_close(void)
+{
+	pthread_mutex_lock(&record_mutex);
+
+	if (replay_data != NULL) {
+		acc_os_mem_free(replay_data);
+		replay_data = NULL;
+	}
+
+	pthread_mutex_unlock(&record_mutex);
+}
+
+
+//-----------------------------
+// Private definitions
+//-----------------------------
+
+bool record_power_on(acc_sensor_id_t sensor_id)
+{
+	uint8_t result = recorded_hal.sensor_device.power_on(sensor_id);
+
+	record_write(RECORD_POWER_ON, sensor_id, &result, sizeof(result));
+
+	return result;
+}
+
+
+bool record_power_off(acc_sensor_id_t sensor_id)
+{
+	uint8_t result = recorded_hal.sensor_device.power_off(sensor_id);
+
+	record_write(RECORD_POWER_OFF, sensor_id, &result, sizeof(result));
+
+	return result;
+}
+
+
+bool record_is_interrupt_active(acc_sensor_id_t sensor_id)
+{
+	uint8_t result = recorded_hal.sensor_device.is_interrupt_active(sensor_id);
+
+	record_write(RECORD_INTERRUPT_ACTIVE, sensor_id, &result, sizeof(result));
+
+	return result;
+}
+
+
+acc_hal_register_isr_status_t record_register_isr(acc_hal_sensor_isr_t isr)
+{
+	ACC_UNUSED(isr);
+
+	// Interrupts are polled through is_interrupt_active so that they are part of the recording
+	return ACC_HAL_REGISTER_ISR_STATUS_UNSUPPORTED;
+}
+
+
+bool record_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_size)
+{
+	pthread_mutex_lock(&record_mutex);
+
+	if ((record_tx_data == NULL) || (buffer_size > record_tx_size)) {
+		pthread_mutex_unlock(&record_mutex);
+		return recorded_hal.sensor_device.transfer(sensor_id, buffer, buffer_size);
+	}
+
+	// The transfer replaces the transmitted data with the received data, and both are recorded
+	memcpy(record_tx_data, buffer, buffer_size);
+
+	bool success = recorded_hal.sensor_device.transfer(sensor_id, buffer, buffer_size);
+
+	if (success) {
+		record_write_locked(RECORD_TRANSFER, sensor_id, record_tx_data, buffer_size, buffer, buffer_size);
+	} else {
+		record_write_locked(RECORD_TRANSFER_FAILED, sensor_id, record_tx_data, buffer_size, NULL, 0);
+	}
+
+	pthread_mutex_unlock(&record_mutex);
+
+	return success;
+}
+
+
+/**
+ * @brief Append a record to the recording
+ *
+ * @param[in] type The record type
+ * @param[in] sensor_id The sensor that was accessed
+ * @param[in] payload The payload, may be NULL if length is zero
+ * @param[in] length The length of the payload
+ */
+void record_write(record_type_t type, acc_sensor_id_t sensor_id, const void *payload, size_t length)
+{
+	pthread_mutex_lock(&record_mutex);
+	record_write_locked(type, sensor_id, payload, length, NULL, 0);
+	pthread_mutex_unlock(&record_mutex);
+}
+
+
+/**
+ * @brief Append a record with a payload in two parts to the recording, must be called with record_mutex locked
+ *
+ * @param[in] type The record type
+ * @param[in] sensor_id The sensor that was accessed
+ * @param[in] payload The first part of the payload, may be NULL if length is zero
+ * @param[in] length The length of the first part
+ * @param[in] payload_tail The second part of the payload, may be NULL if tail_length is zero
+ * @param[in] tail_length The length of the second part
+ */
+void record_write_locked(record_type_t type, acc_sensor_id_t sensor_id, const void *payload, size_t length,
+                         const void *payload_tail, size_t tail_length)
+{
+	if (record_file == NULL) {
+		return;
+	}
+
+	if (length + tail_length > UINT32_MAX) {
+		ACC_LOG_ERROR("Record of %u bytes is too large, recording stopped", (unsigned int)(length + tail_length));
+		fclose(record_file);
+		record_file = NULL;
+		return;
+	}
+
+	uint64_t now_us = time_us();
+	uint64_t delta_us = now_us - previous_record_us;
+
+	record_header_t header = {
+		.delta_us	= (delta_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)delta_us,
+		.length		= (uint32_t)(length + tail_length),
+		.type		= type,
+		.sensor		= sensor_id
+	};
+
+	previous_record_us = now_us;
+
+	if ((fwrite(&header, sizeof(header), 1, record_file) != 1) ||
+	    ((length > 0) && (fwrite(payload, length, 1, record_file) != 1)) ||
+	    ((tail_length > 0) && (fwrite(payload_tail, tail_length, 1, record_file) != 1))) {
+		ACC_LOG_ERROR("Unable to write recording, recording stopped");
+		fclose(record_file);
+		record_file = NULL;
+	}
+}
+
+
+bool replay_power_on(acc_sensor_id_t sensor_id)
+{
+	return replay_result(RECORD_POWER_ON, sensor_id);
+}
+
+
+bool replay_power_off(acc_sensor_id_t sensor_id)
+{
+	return replay_result(RECORD_POWER_OFF, sensor_id);
+}
+
+
+bool replay_is_interrupt_connected(acc_sensor_id_t sensor_id)
+{
+	if ((sensor_id == 0) || (sensor_id > RECORD_SENSOR_COUNT_MAX)) {
+		return false;
+	}
+
+	return (replay_file_header.interrupt_connected_mask & (1 << (sensor_id - 1))) != 0;
+}
+
+
+bool replay_is_interrupt_active(acc_sensor_id_t sensor_id)
+{
+	return replay_result(RECORD_INTERRUPT_ACTIVE, sensor_id);
+}
+
+
+acc_hal_register_isr_status_t replay_register_isr(acc_hal_sensor_isr_t isr)
+{
+	ACC_UNUSED(isr);
+
+	return ACC_HAL_REGISTER_ISR_STATUS_UNSUPPORTED;
+}
+
+
+bool replay_transfer(acc_sensor_id_t sensor_id, uint8_t *buffer, size_t buffer_size)
+{
+	size_t	length;
+	bool	failed;
+	bool	success = false;
+
+	pthread_mutex_lock(&record_mutex);
+
+	const uint8_t	*payload = replay_next(RECORD_TRANSFER, sensor_id, &length, &failed);
+	size_t		recorded_size = failed ? length : length / 2;
+
+	if (payload == NULL) {
+		// The replay diverged, reported by replay_next()
+	} else if ((recorded_size != buffer_size) || (!failed && (length != 2 * buffer_size))) {
+		ACC_LOG_ERROR("Replay diverged, transfer of %u bytes recorded as %u bytes", (unsigned int)buffer_size, (unsigned int)recorded_size);
+	} else if (memcmp(buffer, payload, buffer_size) != 0) {
+		ACC_LOG_ERROR("Replay diverged, transfer of %u bytes sends other data than recorded", (unsigned int)buffer_size);
+	} else if (!failed) {
+		memcpy(buffer, payload + buffer_size, buffer_size);
+		success = true;
+	}
+
+	pthread_mutex_unlock(&record_mutex);
+
+	return success;
+}
+
+
+float replay_get_reference_frequency(void)
+{
+	return replay_file_header.ref_freq;
+}
+
+
+/**
+ * @brief Consume the next record of the replay, must be called with record_mutex locked
+ *
+ * A recorded failed transfer matches a transfer. In real time mode, the call returns no earlier
+ * than the recorded time since the previous record.
+ *
+ * @param[in] type The expected record type
+ * @param[in] sensor_id The expected sensor
+ * @param[out] length The length of the payload
+ * @param[out] failed Set to true if a failed transfer was recorded, or NULL to return NULL for a failed transfer
+ * @return The payload of the record, or NULL if the record does not match
+ */
+const uint8_t *replay_next(record_type_t type, acc_sensor_id_t sensor_id, size_t *length, bool *failed)
+{
+	record_header_t header;
+
+	if ((replay_data == NULL) || ((replay_size - replay_position) < sizeof(header))) {
+		ACC_LOG_ERROR("End of recording reached");
+		return NULL;
+	}
+
+	memcpy(&header, &replay_data[replay_position], sizeof(header));
+
+	bool type_matches = (header.type == type) || ((type == RECORD_TRANSFER) && (header.type == RECORD_TRANSFER_FAILED));
+
+	if (!type_matches || (header.sensor != sensor_id) || ((replay_size - replay_position - sizeof(header)) < header.length)) {
+		ACC_LOG_ERROR("Replay diverged at offset %u", (unsigned int)replay_position);
+		return NULL;
+	}
+
+	replay_position += sizeof(header) + header.length;
+
+	if (replay_speed == ACC_DRIVER_HAL_REPLAY_REAL_TIME) {
+		uint64_t due_us = previous_record_us + header.delta_us;
+
+		acc_driver_os_linux_sleep_until(due_us * 1000);
+		previous_record_us = due_us;
+	}
+
+	if (failed != NULL) {
+		*failed = (header.type == RECORD_TRANSFER_FAILED);
+	} else if (header.type == RECORD_TRANSFER_FAILED) {
+		return NULL;
+	}
+
+	*length = header.length;
+
+	return &replay_data[replay_position - header.length];
+}
+
+
+/**
+ * @brief Replay a record with a boolean result
+ *
+ * @param[in] type The expected record type
+ * @param[in] sensor_id The expected sensor
+ * @return The recorded result, false if the replay diverged
+ */
+bool replay_result(record_type_t type, acc_sensor_id_t sensor_id)
+{
+	size_t length;
+	bool result = false;
+
+	pthread_mutex_lock(&record_mutex);
+
+	const uint8_t *payload = replay_next(type, sensor_id, &length, NULL);
+
+	if ((payload != NULL) && (length == 1)) {
+		result = payload[0] != 0;
+	}
+
+	pthread_mutex_unlock(&record_mutex);
+
+	return result;
+}
+
+
+/**
+ * @brief Get a monotonic time
+ *
+ * @return Time [us]
+ */
+uint64_t time_us(void)
+{
+	return acc_driver_os_linux_time_ns() / 1000;
+}
@@ -3,9 +3,12 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -16,6 +19,7 @@
 #include "acc_device_i2c.h"
 #include "acc_log.h"
 #include "acc_os.h"
+#include "acc_os_linux.h"
 #include "acc_types.h"
 
 
@@ -25,43 +29,272 @@
 #define MODULE		"driver_i2c_linux"
 
 /**
- * @brief The path to the I2C device file to the Kernel
+ * @brief The path to the I2C device file of an adapter to the Kernel
  */
-#define I2C_PATH	"/dev/i2c-1"
+#define I2C_PATH		"/dev/i2c-%u"
+#define I2C_PATH_MAX		(32)
+
+/**
+ * @brief Number of I2C adapters supported, and the adapter used for devices not assigned to any adapter
+ */
+#define I2C_ADAPTER_COUNT_MAX	(8)
+#define I2C_ADAPTER_DEFAULT	(1)
+
+/**
+ * @brief Number of 7-bit I2C device IDs
+ */
+#define I2C_DEVICE_ID_COUNT	(128)
+
+/**
+ * @brief Time during which a failed transfer is retried [us]
+ *
+ * Covers the write cycle of a 24Cxx EEPROM, which does not acknowledge its address for up to 5 ms
+ * after a write.
+ */
+#define I2C_RETRY_TIME_US	(10000)
+
+/**
+ * @brief Delay before the first retry of a failed transfer, doubled for each following retry
+ */
+#define I2C_BACKOFF_US		(5)
+
+/**
+ * @brief Longest delay between two retries
+ */
+#define I2C_BACKOFF_MAX_US	(1000)
+
+/**
+ * @brief Number of asynchronous jobs that can be queued
+ */
+#define JOB_QUEUE_SIZE		(16)
+
+/**
+ * @brief Value of current_device_id when no slave device ID is set on the adapter
+ */
+#define DEVICE_ID_NONE		(-1)
+
+
+/**
+ * @brief An I2C adapter
+ */
+typedef struct {
+	pthread_mutex_t	mutex;			/**< Protects the transfers on the adapter and the fields below */
+	int		fd;			/**< File descriptor of the I2C device file to Kernel, -1 if not open */
+	bool		rdwr_supported;		/**< True if the adapter supports combined transfers with I2C_RDWR */
+	int		current_device_id;	/**< The slave device ID last set with I2C_SLAVE */
+} adapter_t;
+
+#define ADAPTER_INIT { .mutex = PTHREAD_MUTEX_INITIALIZER, .fd = -1, .current_device_id = DEVICE_ID_NONE }
+
+
+/**
+ * @brief The I2C adapters, opened on demand by the first transfer
+ */
+static adapter_t	adapters[I2C_ADAPTER_COUNT_MAX] = {
+	ADAPTER_INIT, ADAPTER_INIT, ADAPTER_INIT, ADAPTER_INIT,
+	ADAPTER_INIT, ADAPTER_INIT, ADAPTER_INIT, ADAPTER_INIT
+};
+
+/**
+ * @brief The adapter of each device ID, plus one so that 0 means the default adapter
+ */
+static uint8_t		device_adapter[I2C_DEVICE_ID_COUNT];
+
+
+/**
+ * @brief An asynchronous transfer
+ */
+typedef struct {
+	bool					write;
+	uint8_t					device_id;
+	uint16_t				address;
+	uint_fast8_t				address_size;
+	uint8_t					*buffer;
+	size_t					buffer_size;
+	acc_driver_i2c_linux_callback_t		callback;
+	void					*user_data;
+} job_t;
+
+
+/**
+ * @brief Queue of asynchronous transfers, run in order by the worker thread
+ */
+static pthread_mutex_t	job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	job_cond = PTHREAD_COND_INITIALIZER;
+static job_t		jobs[JOB_QUEUE_SIZE];
+static uint_fast8_t	job_head = 0;
+static uint_fast8_t	job_count = 0;
+
+/**
+ * @brief The worker thread, NULL if not started
+ */
+static acc_os_thread_handle_t	job_worker_thread = NULL;
+
+/**
+ * @brief True while the worker runs a transfer or its callback
+ */
+static bool		job_running = false;
+
+/**
+ * @brief True when the worker is to exit once the queue is empty
+ */
+static bool		job_worker_stopping = false;
+
+/**
+ * @brief Signaled when the worker has finished a transfer and the queue may be empty, and when a stop is done
+ */
+static pthread_cond_t	job_done_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief True on the worker thread, where callbacks may queue more transfers
+ */
+static __thread bool	job_in_worker = false;
+
+
+/**
+ * @brief Wait before retrying a failed transfer
+ *
+ * A device that is only briefly busy is retried after a few microseconds, while the retries of a
+ * device that stays busy span I2C_RETRY_TIME_US with at most I2C_BACKOFF_MAX_US between them.
+ *
+ * @param attempt The number of the attempt that failed, starting from 0
+ * @param start_ns The time of the first attempt [ns]
+ * @return True if the transfer should be retried, false when the retry time is used up
+ */
+static bool backoff(uint_fast8_t attempt, uint64_t start_ns)
+{
+	if (acc_driver_os_linux_time_ns() - start_ns >= (uint64_t)I2C_RETRY_TIME_US * 1000) {
+		return false;
+	}
+
+	uint32_t delay_us = (attempt < 8) ? (uint32_t)I2C_BACKOFF_US << attempt : I2C_BACKOFF_MAX_US;
+
+	acc_os_sleep_us((delay_us < I2C_BACKOFF_MAX_US) ? delay_us : I2C_BACKOFF_MAX_US);
+
+	return true;
+}
 
 
 /**
- * @brief File descriptor of I2C device file to Kernel
+ * @brief Check if a transfer failed because no device acknowledged it
+ *
+ * A missing device, such as the EEPROM of a board that has none, is expected and is only logged verbosely.
+ *
+ * @param error The errno of the failed transfer
+ * @return True if the device did not acknowledge the transfer
  */
-static int		i2c_fd = -1;
+static bool no_acknowledge(int error)
+{
+	return (error == ENXIO) || (error == EREMOTEIO);
+}
+
 
 /**
- * @brief Mutex to protect I2C transfers
+ * @brief Internal I2C combined transfer
+ *
+ * Does an I2C_RDWR ioctl on the adapter, with a repeated START between the messages and a single STOP
+ * at the end. Retries with an increasing delay only if the transfer fails.
+ *
+ * @param adapter The adapter, locked and open
+ * @param messages The messages of the transfer
+ * @param message_count The number of messages
+ * @return True if the transfer was successful
  */
-static pthread_mutex_t	i2c_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool internal_transfer(adapter_t *adapter, struct i2c_msg *messages, uint_fast8_t message_count)
+{
+	struct i2c_rdwr_ioctl_data	data = {
+		.msgs	= messages,
+		.nmsgs	= message_count
+	};
+	int				result;
+	int				error = 0;
+
+	uint64_t start_ns = acc_driver_os_linux_time_ns();
+
+	for (uint_fast8_t attempt = 0; ; attempt++) {
+		result = ioctl(adapter->fd, I2C_RDWR, &data);
+		error = errno;
+		if (result >= 0 || !backoff(attempt, start_ns)) {
+			break;
+		}
+	}
+
+	if (result < 0) {
+		if (no_acknowledge(error)) {
+			ACC_LOG_VERBOSE("No i2c device 0x%02x acknowledged: (%d) %s", (unsigned int)messages[0].addr, error, strerror(error));
+		} else {
+			ACC_LOG_ERROR("Could not transfer to i2c device 0x%02x: (%d) %s", (unsigned int)messages[0].addr, error, strerror(error));
+		}
+		return false;
+	}
+
+	if (result != (int)message_count) {
+		ACC_LOG_ERROR("Number of messages transferred was %d, but should be %u", result, (unsigned int)message_count);
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Set the slave device ID for read() and write() on an adapter
+ *
+ * The ioctl is only issued when the device ID differs from the one set last.
+ *
+ * @param adapter The adapter, locked and open
+ * @param device_id The device ID
+ * @return True if the device ID is set
+ */
+static bool set_device_id(adapter_t *adapter, uint8_t device_id)
+{
+	if (adapter->current_device_id == device_id) {
+		return true;
+	}
+
+	if (ioctl(adapter->fd, I2C_SLAVE, device_id) < 0) {
+		ACC_LOG_ERROR("Could not set i2c slave device ID %u: (%d) %s", (unsigned int)device_id, errno, strerror(errno));
+		adapter->current_device_id = DEVICE_ID_NONE;
+		return false;
+	}
+
+	adapter->current_device_id = device_id;
+
+	return true;
+}
 
 
 /**
  * @brief Internal I2C read
  *
- * Does a read() on i2c_fd until success or timeout. Assumes that a device ID and optionally an address have already been set.
+ * Does a read() on the adapter until success or timeout. Assumes that a device ID and optionally an address have already been set.
  *
+ * @param adapter The adapter, locked and open
  * @param buffer The result of the read is stored here
  * @param buffer_size The size of the buffer
  * @return True if the read was successful
  */
-static bool internal_read(uint8_t *buffer, size_t buffer_size)
+static bool internal_read(adapter_t *adapter, uint8_t *buffer, size_t buffer_size)
 {
 	ssize_t bytes_read;
-	uint_fast8_t retry = 200;
+	int	error = 0;
 
-	do {
-		bytes_read = read(i2c_fd, buffer, buffer_size);
-		acc_os_sleep_us(5);
-	} while (bytes_read < 0 && retry--);
+	uint64_t start_ns = acc_driver_os_linux_time_ns();
+
+	for (uint_fast8_t attempt = 0; ; attempt++) {
+		bytes_read = read(adapter->fd, buffer, buffer_size);
+		error = errno;
+		if (bytes_read >= 0 || !backoff(attempt, start_ns)) {
+			break;
+		}
+	}
 
 	if (bytes_read < 0) {
-		ACC_LOG_ERROR("Could not read from i2c device: (%d) %s", errno, strerror(errno));
+		if (no_acknowledge(error)) {
+			ACC_LOG_VERBOSE("No i2c device acknowledged the read: (%d) %s", error, strerror(error));
+		} else {
+			ACC_LOG_ERROR("Could not read from i2c device: (%d) %s", error, strerror(error));
+		}
 		return false;
 	}
 
@@ -77,24 +310,34 @@ static bool internal_read(uint8_t *buffer, size_t buffer_size)
 /**
  * @brief Internal I2C write
  *
- * Does a write() on i2c_fd until success or timeout. Assumes that a device ID and optionally an address have already been set.
+ * Does a write() on the adapter until success or timeout. Assumes that a device ID and optionally an address have already been set.
  *
+ * @param adapter The adapter, locked and open
  * @param buffer The data to be written
  * @param buffer_size The size of the buffer
  * @return True if the write was successful
  */
-static bool internal_write(uint8_t *buffer, size_t buffer_size)
+static bool internal_write(adapter_t *adapter, uint8_t *buffer, size_t buffer_size)
 {
 	ssize_t bytes_written;
-	uint_fast8_t retry = 200;
+	int	error = 0;
+
+	uint64_t start_ns = acc_driver_os_linux_time_ns();
 
-	do {
-		bytes_written = write(i2c_fd, buffer, buffer_size);
-		acc_os_sleep_us(5);
-	} while (bytes_written < 0 && retry--);
+	for (uint_fast8_t attempt = 0; ; attempt++) {
+		bytes_written = write(adapter->fd, buffer, buffer_size);
+		error = errno;
+		if (bytes_written >= 0 || !backoff(attempt, start_ns)) {
+			break;
+		}
+	}
 
 	if (bytes_written < 0) {
-		ACC_LOG_ERROR("Could not write to i2c device: (%d) %s", errno, strerror(errno));
+		if (no_acknowledge(error)) {
+			ACC_LOG_VERBOSE("No i2c device acknowledged the write: (%d) %s", error, strerror(error));
+		} else {
+			ACC_LOG_ERROR("Could not write to i2c device: (%d) %s", error, strerror(error));
+		}
 		return false;
 	}
 
@@ -108,30 +351,84 @@ static bool internal_write(uint8_t *buffer, size_t buffer_size)
 
 
 /**
- * @brief Initialize I2C driver
+ * @brief Open an adapter
  *
- * @return Status
+ * @param adapter The adapter, locked
+ * @param adapter_number The number of the adapter
+ * @return True if the adapter is open
  */
-static acc_status_t acc_driver_i2c_linux_init(void)
+static bool adapter_open(adapter_t *adapter, uint_fast8_t adapter_number)
 {
-	static pthread_mutex_t	init_mutex = PTHREAD_MUTEX_INITIALIZER;
-	static bool		init_done;
+	char		path[I2C_PATH_MAX];
+	unsigned long	functionality = 0;
+
+	snprintf(path, sizeof(path), I2C_PATH, (unsigned int)adapter_number);
+
+	if ((adapter->fd = open(path, O_RDWR)) < 0) {
+		if (errno == ENOENT) {
+			// Raspbian does not enable i2c-dev by default, the caller decides whether that is an error
+			ACC_LOG_VERBOSE("i2c adapter %s is not present", path);
+		} else {
+			ACC_LOG_ERROR("Unable to open i2c connection %s: %s", path, strerror(errno));
+		}
+		return false;
+	}
 
-	pthread_mutex_lock(&init_mutex);
-	if (init_done) {
-		pthread_mutex_unlock(&init_mutex);
-		return ACC_STATUS_SUCCESS;
+	if (ioctl(adapter->fd, I2C_FUNCS, &functionality) < 0) {
+		ACC_LOG_WARNING("Unable to get functionality of i2c adapter %s: %s", path, strerror(errno));
 	}
 
-	if ((i2c_fd = open(I2C_PATH, O_RDWR)) < 0) {
-		ACC_LOG_FATAL("Unable to open i2c connection: %s", strerror(errno));
-		pthread_mutex_unlock(&init_mutex);
-		return ACC_STATUS_FAILURE;
+	adapter->rdwr_supported		= (functionality & I2C_FUNC_I2C) != 0;
+	adapter->current_device_id	= DEVICE_ID_NONE;
+
+	if (!adapter->rdwr_supported) {
+		ACC_LOG_VERBOSE("i2c adapter %s does not support combined transfers, using read and write", path);
 	}
 
-	init_done = true;
-	pthread_mutex_unlock(&init_mutex);
+	return true;
+}
 
+
+/**
+ * @brief Lock the adapter of a device, opening the adapter if needed
+ *
+ * @param device_id The ID of the device
+ * @return The locked adapter, or NULL if the adapter could not be opened
+ */
+static adapter_t *adapter_lock(uint8_t device_id)
+{
+	uint_fast8_t adapter_number = I2C_ADAPTER_DEFAULT;
+
+	if (device_id < I2C_DEVICE_ID_COUNT) {
+		uint8_t assigned = __atomic_load_n(&device_adapter[device_id], __ATOMIC_RELAXED);
+
+		if (assigned != 0) {
+			adapter_number = assigned - 1;
+		}
+	}
+
+	adapter_t *adapter = &adapters[adapter_number];
+
+	pthread_mutex_lock(&adapter->mutex);
+
+	if (adapter->fd < 0 && !adapter_open(adapter, adapter_number)) {
+		pthread_mutex_unlock(&adapter->mutex);
+		return NULL;
+	}
+
+	return adapter;
+}
+
+
+/**
+ * @brief Initialize I2C driver
+ *
+ * The adapters are opened on demand by the first transfer to a device on them.
+ *
+ * @return Status
+ */
+static acc_status_t acc_driver_i2c_linux_init(void)
+{
 	return ACC_STATUS_SUCCESS;
 }
 
@@ -151,6 +448,10 @@ static acc_status_t acc_driver_i2c_linux_init(void)
  */
 static acc_status_t acc_driver_i2c_linux_write_to_address_internal(uint8_t device_id, uint16_t address, uint_fast8_t address_size, const uint8_t *buffer, size_t buffer_size)
 {
+	if (address_size + buffer_size > UINT16_MAX) {
+		return ACC_STATUS_BAD_PARAM;
+	}
+
 	size_t write_data_size = address_size + buffer_size;
 	uint8_t write_data[write_data_size];
 
@@ -164,17 +465,28 @@ static acc_status_t acc_driver_i2c_linux_write_to_address_internal(uint8_t devic
 	}
 	memcpy(&write_data[address_size], buffer, buffer_size);
 
-	pthread_mutex_lock(&i2c_mutex);
+	adapter_t *adapter = adapter_lock(device_id);
 
-	if (ioctl(i2c_fd, 0x0703, device_id) < 0) {
-		ACC_LOG_ERROR("Could not set i2c slave device ID %u", device_id);
-		pthread_mutex_unlock(&i2c_mutex);
+	if (adapter == NULL) {
 		return ACC_STATUS_FAILURE;
 	}
 
-	bool success = internal_write(write_data, write_data_size);
+	bool success;
 
-	pthread_mutex_unlock(&i2c_mutex);
+	if (adapter->rdwr_supported) {
+		struct i2c_msg message = {
+			.addr	= device_id,
+			.flags	= 0,
+			.len	= write_data_size,
+			.buf	= write_data
+		};
+
+		success = internal_transfer(adapter, &message, 1);
+	} else {
+		success = set_device_id(adapter, device_id) && internal_write(adapter, write_data, write_data_size);
+	}
+
+	pthread_mutex_unlock(&adapter->mutex);
 
 	return success ? ACC_STATUS_SUCCESS : ACC_STATUS_FAILURE;
 }
@@ -231,6 +543,10 @@ static acc_status_t acc_driver_i2c_linux_write_to_address_16(uint8_t device_id,
  */
 static acc_status_t acc_driver_i2c_linux_read_from_address_internal(uint8_t device_id, uint16_t address, uint_fast8_t address_size, uint8_t *buffer , size_t buffer_size)
 {
+	if (buffer_size > UINT16_MAX) {
+		return ACC_STATUS_BAD_PARAM;
+	}
+
 	uint8_t write_data[address_size];
 
 	if (address_size == 1) {
@@ -242,27 +558,40 @@ static acc_status_t acc_driver_i2c_linux_read_from_address_internal(uint8_t devi
 		return ACC_STATUS_BAD_PARAM;
 	}
 
-	pthread_mutex_lock(&i2c_mutex);
+	adapter_t *adapter = adapter_lock(device_id);
 
-	if (ioctl(i2c_fd, 0x0703, device_id) < 0) {
-		ACC_LOG_ERROR("Could not set i2c slave device ID %" PRIu8, device_id);
-		pthread_mutex_unlock(&i2c_mutex);
+	if (adapter == NULL) {
 		return ACC_STATUS_FAILURE;
 	}
 
-	if (!internal_write(write_data, address_size)) {
-		pthread_mutex_unlock(&i2c_mutex);
-		return ACC_STATUS_FAILURE;
-	}
-
-	if (!internal_read(buffer, buffer_size)) {
-		pthread_mutex_unlock(&i2c_mutex);
-		return ACC_STATUS_FAILURE;
+	bool success;
+
+	if (adapter->rdwr_supported) {
+		// Address write and data read in one transfer, with a repeated START in between
+		struct i2c_msg messages[] = {
+			{
+				.addr	= device_id,
+				.flags	= 0,
+				.len	= address_size,
+				.buf	= write_data
+			},
+			{
+				.addr	= device_id,
+				.flags	= I2C_M_RD,
+				.len	= buffer_size,
+				.buf	= buffer
+			}
+		};
+
+		success = internal_transfer(adapter, messages, 2);
+	} else {
+		success = set_device_id(adapter, device_id) && internal_write(adapter, write_data, address_size) &&
+		          internal_read(adapter, buffer, buffer_size);
 	}
 
-	pthread_mutex_unlock(&i2c_mutex);
+	pthread_mutex_unlock(&adapter->mutex);
 
-	return ACC_STATUS_SUCCESS;
+	return success ? ACC_STATUS_SUCCESS : ACC_STATUS_FAILURE;
 }
 
 
@@ -316,22 +645,229 @@ static acc_status_t acc_driver_i2c_linux_read_from_address_16(uint8_t device_id,
  */
 static acc_status_t acc_driver_i2c_linux_read(uint8_t device_id, uint8_t *buffer, size_t buffer_size)
 {
-	pthread_mutex_lock(&i2c_mutex);
+	adapter_t *adapter = adapter_lock(device_id);
 
-	if (ioctl(i2c_fd, 0x0703, device_id) < 0) {
-		ACC_LOG_ERROR("Could not set i2c device ID %u: (%u) %s", device_id, errno, strerror(errno));
-		pthread_mutex_unlock(&i2c_mutex);
+	if (adapter == NULL) {
 		return ACC_STATUS_FAILURE;
 	}
 
-	bool success = internal_read(buffer, buffer_size);
+	bool success = set_device_id(adapter, device_id) && internal_read(adapter, buffer, buffer_size);
 
-	pthread_mutex_unlock(&i2c_mutex);
+	pthread_mutex_unlock(&adapter->mutex);
 
 	return success ? ACC_STATUS_SUCCESS : ACC_STATUS_FAILURE;
 }
 
 
+/**
+ * @brief Run an asynchronous transfer
+ *
+ * @param job The transfer
+ * @return Status
+ */
+static acc_status_t job_run(const job_t *job)
+{
+	if (job->write) {
+		return acc_driver_i2c_linux_write_to_address_internal(job->device_id, job->address, job->address_size, job->buffer, job->buffer_size);
+	}
+
+	if (job->address_size == 0) {
+		return acc_driver_i2c_linux_read(job->device_id, job->buffer, job->buffer_size);
+	}
+
+	return acc_driver_i2c_linux_read_from_address_internal(job->device_id, job->address, job->address_size, job->buffer, job->buffer_size);
+}
+
+
+/**
+ * @brief The worker thread, runs the queued transfers and reports their completion until stopped
+ *
+ * @param param Not used
+ */
+static void job_worker(void *param)
+{
+	(void)param;
+
+	job_in_worker = true;
+
+	pthread_mutex_lock(&job_mutex);
+
+	for (;;) {
+		while ((job_count == 0) && !job_worker_stopping) {
+			pthread_cond_wait(&job_cond, &job_mutex);
+		}
+
+		// The queue is drained before the worker exits
+		if (job_count == 0) {
+			break;
+		}
+
+		job_t job = jobs[job_head];
+
+		job_head = (job_head + 1) % JOB_QUEUE_SIZE;
+		job_count--;
+		job_running = true;
+		pthread_mutex_unlock(&job_mutex);
+
+		acc_status_t status = job_run(&job);
+
+		if (job.callback != NULL) {
+			job.callback(status, job.user_data);
+		}
+
+		pthread_mutex_lock(&job_mutex);
+		job_running = false;
+		pthread_cond_broadcast(&job_done_cond);
+	}
+
+	pthread_mutex_unlock(&job_mutex);
+}
+
+
+/**
+ * @brief Queue an asynchronous transfer, starting the worker thread if needed
+ *
+ * @param job The transfer
+ * @return Status
+ */
+static acc_status_t job_submit(const job_t *job)
+{
+	if ((job->address_size > 2) || (job->write && job->address_size == 0)) {
+		return ACC_STATUS_BAD_PARAM;
+	}
+
+	pthread_mutex_lock(&job_mutex);
+
+	/*
+	 * A worker that is stopping may already have drained the queue and exited, so other threads wait
+	 * for the stop to finish and then start a new worker. Transfers queued by callbacks are run by the
+	 * stopping worker before it exits.
+	 */
+	while (job_worker_stopping && !job_in_worker) {
+		pthread_cond_wait(&job_done_cond, &job_mutex);
+	}
+
+	if (job_worker_thread == NULL) {
+		// Board housekeeping, so the attributes set for the radar threads are not used
+		acc_driver_os_linux_thread_attributes_t attributes = ACC_DRIVER_OS_LINUX_THREAD_ATTRIBUTES_DEFAULT;
+		acc_driver_os_linux_thread_attributes_t radar_attributes;
+
+		acc_driver_os_linux_get_thread_attributes(&radar_attributes);
+		attributes.name			= "acc_i2c";
+		attributes.stack_tracking	= radar_attributes.stack_tracking;
+
+		job_worker_thread = acc_driver_os_linux_thread_create_ex(job_worker, NULL, &attributes);
+		if (job_worker_thread == NULL) {
+			ACC_LOG_ERROR("Unable to create i2c worker thread");
+			pthread_mutex_unlock(&job_mutex);
+			return ACC_STATUS_FAILURE;
+		}
+	}
+
+	if (job_count == JOB_QUEUE_SIZE) {
+		ACC_LOG_WARNING("i2c job queue is full");
+		pthread_mutex_unlock(&job_mutex);
+		return ACC_STATUS_OUT_OF_MEMORY;
+	}
+
+	jobs[(job_head + job_count) % JOB_QUEUE_SIZE] = *job;
+	job_count++;
+
+	pthread_cond_signal(&job_cond);
+	pthread_mutex_unlock(&job_mutex);
+
+	return ACC_STATUS_SUCCESS;
+}
+
+
+acc_status_t acc_driver_i2c_linux_read_async(uint8_t device_id, uint16_t address, uint_fast8_t address_size, uint8_t *buffer, size_t buffer_size,
+                                             acc_driver_i2c_linux_callback_t callback, void *user_data)
+{
+	job_t job = {
+		.write		= false,
+		.device_id	= device_id,
+		.address	= address,
+		.address_size	= address_size,
+		.buffer		= buffer,
+		.buffer_size	= buffer_size,
+		.callback	= callback,
+		.user_data	= user_data
+	};
+
+	return job_submit(&job);
+}
+
+
+acc_status_t acc_driver_i2c_linux_write_async(uint8_t device_id, uint16_t address, uint_fast8_t address_size, const uint8_t *buffer, size_t buffer_size,
+                                              acc_driver_i2c_linux_callback_t callback, void *user_data)
+{
+	job_t job = {
+		.write		= true,
+		.device_id	= device_id,
+		.address	= address,
+		.address_size	= address_size,
+		.buffer		= (uint8_t *)buffer,
+		.buffer_size	= buffer_size,
+		.callback	= callback,
+		.user_data	= user_data
+	};
+
+	return job_submit(&job);
+}
+
+
+void acc_driver_i2c_linux_drain(void)
+{
+	pthread_mutex_lock(&job_mutex);
+	while ((job_count > 0) || job_running) {
+		pthread_cond_wait(&job_done_cond, &job_mutex);
+	}
+	pthread_mutex_unlock(&job_mutex);
+}
+
+
+void acc_driver_i2c_linux_stop(void)
+{
+	pthread_mutex_lock(&job_mutex);
+
+	// A concurrent stop cleans up the worker
+	while (job_worker_stopping) {
+		pthread_cond_wait(&job_done_cond, &job_mutex);
+	}
+
+	acc_os_thread_handle_t thread = job_worker_thread;
+
+	if (thread == NULL) {
+		pthread_mutex_unlock(&job_mutex);
+		return;
+	}
+
+	job_worker_stopping = true;
+	pthread_cond_signal(&job_cond);
+	pthread_mutex_unlock(&job_mutex);
+
+	acc_os_thread_cleanup(thread);
+
+	pthread_mutex_lock(&job_mutex);
+	job_worker_thread	= NULL;
+	job_worker_stopping	= false;
+	pthread_cond_broadcast(&job_done_cond);
+	pthread_mutex_unlock(&job_mutex);
+}
+
+
+acc_status_t acc_driver_i2c_linux_set_adapter(uint8_t device_id, uint_fast8_t adapter)
+{
+	if (device_id >= I2C_DEVICE_ID_COUNT || adapter >= I2C_ADAPTER_COUNT_MAX) {
+		return ACC_STATUS_BAD_PARAM;
+	}
+
+	__atomic_store_n(&device_adapter[device_id], (uint8_t)(adapter + 1), __ATOMIC_RELAXED);
+
+	return ACC_STATUS_SUCCESS;
+}
+
+
 /**
  * @brief Request driver to register with appropriate device(s)
  */
@@ -68,7 +68,7 @@ static int spidev_fd[SPI_BUS_MAX][SPI_BUS_DEVICE_MAX];
 static acc_status_t internal_spi_open(uint_fast8_t bus, uint_fast8_t device)
 {
 	uint32_t	mode = 0;
-	char		spidev[sizeof(SPIDEV_PATH) + 1];
+	char		spidev[sizeof(SPIDEV_PATH) + 4];
 
 	snprintf(spidev, sizeof(spidev), SPIDEV_PATH, bus, device);
 
@@ -132,18 +132,33 @@ static acc_status_t acc_driver_spi_linux_spidev_transfer(
 		uint32_t	speed,
 		uint8_t		*buffer,
 		size_t		buffer_size)
+{
+	int fd = acc_driver_spi_linux_spidev_get_fd(bus, device);
+
+	if (fd < 0) {
+		return ((bus >= SPI_BUS_MAX) || (device >= SPI_BUS_DEVICE_MAX)) ? ACC_STATUS_BAD_PARAM : ACC_STATUS_FAILURE;
+	}
+
+	return acc_driver_spi_linux_spidev_transfer_fd(fd, speed, buffer, buffer_size);
+}
+
+
+int acc_driver_spi_linux_spidev_get_fd(uint_fast8_t bus, uint_fast8_t device)
 {
 	if ((bus >= SPI_BUS_MAX) || (device >= SPI_BUS_DEVICE_MAX)) {
-		return ACC_STATUS_BAD_PARAM;
+		return -1;
 	}
 
 	if (spidev_fd[bus][device] < 0) {
 		internal_spi_open(bus, device);
 	}
-	if (spidev_fd[bus][device] < 0) {
-		return ACC_STATUS_FAILURE;
-	}
 
+	return spidev_fd[bus][device];
+}
+
+
+acc_status_t acc_driver_spi_linux_spidev_transfer_fd(int fd, uint32_t speed, uint8_t *buffer, size_t buffer_size)
+{
 	spidev_transfer_t spi_transfer = {
 		.tx		= (uintptr_t)buffer,
 		.rx		= (uintptr_t)buffer,
@@ -155,7 +170,7 @@ static acc_status_t acc_driver_spi_linux_spidev_transfer(
 		.pad		= 0,
 	};
 
-	int ret_val = ioctl(spidev_fd[bus][device], _IOW('k', 0, char[ACC_SPI_TRANSFER_SIZE(1)]), &spi_transfer);
+	int ret_val = ioctl(fd, _IOW('k', 0, char[ACC_SPI_TRANSFER_SIZE(1)]), &spi_transfer);
 	if (ret_val < 0) {
 		ACC_LOG_ERROR("SPI transfer failure: %s", strerror(errno));
 		return ACC_STATUS_FAILURE;
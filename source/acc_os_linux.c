@@ -16,10 +16,10 @@
 
 #include <dlfcn.h>
 #include <errno.h>
+#include <limits.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stddef.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -47,15 +48,33 @@
 
 #define ACC_OS_INVALID_SOCKET	(-1)
 
+/**
+ * @brief Number of threads with stack tracking listed in the stack report
+ */
+#define STACK_RECORD_COUNT_MAX	(32)
+
+/**
+ * @brief Number of pages checked for residency per system call when measuring stack usage
+ */
+#define STACK_RESIDENCY_CHUNK	(256)
+
+/**
+ * @brief Lock pages as they are faulted in, from linux/mman.h which is not included by older C libraries
+ */
+#if !defined(MLOCK_ONFAULT)
+#define MLOCK_ONFAULT		(0x01)
+#endif
+
 typedef struct acc_os_mutex {
-	uint_fast8_t		is_initialized;
-	pthread_mutex_t		mutex;
+	uint_fast8_t				is_initialized;
+	pthread_mutex_t				mutex;
+	acc_driver_os_linux_futex_mutex_t	futex_mutex;
 } acc_os_mutex_s;
 
 
 typedef struct acc_os_semaphore {
-	uint_fast8_t	  	is_initialized;
-	sem_t			handle;
+	uint_fast8_t				is_initialized;
+	acc_driver_os_linux_futex_semaphore_t	semaphore;
 } acc_os_semaphore_s;
 
 
@@ -66,14 +85,89 @@ typedef struct acc_os_socket {
 
 typedef struct acc_os_thread_handle {
 	pthread_t handle;
+	void (*func)(void *param);
+	void *param;
+	uint8_t *stack_mapping;		// Stack mapped by the driver, with a guard page first, NULL if not tracked
+	size_t stack_mapping_size;
+	int_fast8_t stack_record;	// Index in stack_records, -1 if the thread is not listed
 }acc_os_thread_handle_s;
 
 
+/**
+ * @brief Stack usage of a thread created with stack tracking
+ *
+ * The record of a cleaned up thread keeps its high-water mark and is reused by the next thread with
+ * the same name, so that threads created on every activation do not fill the list.
+ */
+typedef struct {
+	bool			in_use;
+	char			name[16];
+	size_t			stack_size;
+	size_t			peak_usage;
+	acc_os_thread_handle_t	thread;		// The running thread, NULL when cleaned up
+} stack_record_t;
+
+
+/**
+ * @brief Header in front of every allocation when heap accounting is enabled
+ *
+ * Sized to keep the memory after it naturally aligned.
+ */
+typedef union {
+	struct {
+		uint32_t	size;
+		uint32_t	site;
+	}		accounting;
+	uint64_t	align_u64;
+	double		align_double;
+	void		*align_pointer;
+} mem_header_t;
+
+
+/**
+ * @brief The allocator to register, and if the driver has been registered
+ */
+static acc_driver_os_linux_allocator_t	allocator = ACC_DRIVER_OS_LINUX_ALLOCATOR_MALLOC;
+static bool				registered = false;
+
+/**
+ * @brief Attributes of the threads created by acc_os_thread_create()
+ */
+static acc_driver_os_linux_thread_attributes_t	thread_attributes = ACC_DRIVER_OS_LINUX_THREAD_ATTRIBUTES_DEFAULT;
+
+/**
+ * @brief True if acc_os_mutex_t is backed by futex mutexes
+ */
+static bool				futex_mutex = false;
+
+/**
+ * @brief True if heap accounting is enabled
+ */
+static bool				mem_accounting = false;
+
+/**
+ * @brief The allocator behind the arena scopes
+ */
+static void				*(*base_mem_alloc)(size_t size) = malloc;
+static void				(*base_mem_free)(void *ptr) = free;
+
+
 /**
  * @brief Flag set if stack has been prepared for usage measurement
  */
 static uint_fast8_t acc_os_stack_setup_done = 0;
 
+/**
+ * @brief Threads created with stack tracking, for the stack report
+ */
+static stack_record_t	stack_records[STACK_RECORD_COUNT_MAX];
+static pthread_mutex_t	stack_records_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The handle of the calling thread, NULL for threads not created by the driver
+ */
+static __thread acc_os_thread_handle_t current_thread = NULL;
+
 
 /**
  * @brief General signal handler registered by os_init()
@@ -110,9 +204,79 @@ static void acc_driver_os_init(void)
 }
 
 
+/**
+ * @brief Find the lowest resident page of a stack
+ *
+ * @param stack Lowest address of the stack, page aligned
+ * @param page_count Number of pages of the stack
+ * @param page_size The page size
+ * @return Index of the lowest resident page, page_count if no page is resident
+ */
+static size_t stack_first_resident_page(const uint8_t *stack, size_t page_count, size_t page_size)
+{
+	unsigned char resident[STACK_RESIDENCY_CHUNK];
+
+	for (size_t page = 0; page < page_count; page += STACK_RESIDENCY_CHUNK) {
+		size_t count = (page_count - page < STACK_RESIDENCY_CHUNK) ? page_count - page : STACK_RESIDENCY_CHUNK;
+
+		if (mincore((void *)(stack + (page * page_size)), count * page_size, resident) != 0) {
+			// Part of the range is not mapped, as below the main thread stack, check the pages one by one
+			for (size_t index = 0; index < count; index++) {
+				if (mincore((void *)(stack + ((page + index) * page_size)), page_size, &resident[index]) != 0) {
+					resident[index] = 0;
+				}
+			}
+		}
+
+		for (size_t index = 0; index < count; index++) {
+			if (resident[index] & 1) {
+				return page + index;
+			}
+		}
+	}
+
+	return page_count;
+}
+
+
+/**
+ * @brief Measure the stack high-water mark of a stack that grows downwards
+ *
+ * Stack pages are not resident until the thread first uses them, so the deepest page used is the
+ * lowest resident page, and the usage is counted from its start. The result is rounded up to whole
+ * pages, it is never less than the real usage as long as no used page has been swapped out. The
+ * pages are never read, so measuring neither makes them resident nor walks the unused stack.
+ *
+ * @param stack Lowest address of the stack
+ * @param stack_size Size of the stack in bytes
+ * @return Number of bytes of used stack space
+ */
+static size_t stack_high_water(const uint8_t *stack, size_t stack_size)
+{
+	size_t		page_size = (size_t)sysconf(_SC_PAGESIZE);
+	const uint8_t	*stack_end = stack + stack_size;
+	uintptr_t	first_page = ((uintptr_t)stack + page_size - 1) & ~(uintptr_t)(page_size - 1);
+
+	if (first_page >= (uintptr_t)stack_end) {
+		return 0;
+	}
+
+	size_t		page_count = ((uintptr_t)stack_end - first_page) / page_size;
+	size_t		page = stack_first_resident_page((const uint8_t *)first_page, page_count, page_size);
+
+	if (page == page_count) {
+		return 0;
+	}
+
+	return (size_t)(stack_end - (const uint8_t *)(first_page + (page * page_size)));
+}
+
+
 /**
  * @brief Prepare stack for measuring stack usage - to be called as early as possible
  *
+ * Nothing is painted, the stack is measured through the pages the kernel has made resident.
+ *
  * @param stack_size Amount of stack in bytes that is allocated
  */
 static void acc_driver_os_stack_setup(size_t stack_size)
@@ -120,18 +284,16 @@ static void acc_driver_os_stack_setup(size_t stack_size)
 	if (!stack_size)
 		return;
 
-	uint8_t stack_filler[stack_size];
-	memset(stack_filler, 0x5a, sizeof(stack_filler));
-
-	/* Prevent compiler from optimizing away stack_filler[] */
-	__asm__ __volatile__("" :: "m" (stack_filler));
-
 	acc_os_stack_setup_done = 1;
 }
 
 
 /**
- * @brief Measure amount of used stack in bytes
+ * @brief Measure amount of used stack in bytes of the calling thread
+ *
+ * Rounded up to whole pages. Other threads than those created with stack tracking are measured on
+ * the stack that the C library gave them, which may be reused from an earlier thread and then include
+ * its usage, and which may have pages swapped out that are then not counted.
  *
  * @param stack_size Amount of stack in bytes that is allocated
  * @return Number of bytes of used stack space
@@ -141,17 +303,26 @@ static size_t acc_driver_os_stack_get_usage(size_t stack_size)
 	if (!stack_size || !acc_os_stack_setup_done)
 		return 0;
 
-	uint8_t stack_filler[stack_size];
-	size_t	usage = 0;
+	if (current_thread != NULL && current_thread->stack_mapping != NULL) {
+		return acc_driver_os_linux_thread_get_stack_usage(current_thread);
+	}
+
+	pthread_attr_t	attr;
+	void		*stack;
+	size_t		size;
+
+	if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+		return 0;
+	}
+
+	int ret = pthread_attr_getstack(&attr, &stack, &size);
+	pthread_attr_destroy(&attr);
 
-	/* This does not give an exact figure but is useful as an indication of the used size.
-	   The reason for counting backwards to allow future improvement handling any misalignment
-	   garbage at the end. */
-	for (size_t index = stack_size - 1; index; index--)
-		if (stack_filler[index] != 0x5a)
-			usage += 1;
+	if (ret != 0) {
+		return 0;
+	}
 
-	return usage;
+	return stack_high_water(stack, size);
 }
 
 
@@ -175,6 +346,86 @@ static void acc_driver_os_sleep_us(uint32_t time_usec)
 }
 
 
+/**
+ * @brief Allocate dynamic memory, from the arena scope of the thread if one is open
+ *
+ * @param size The number of bytes to allocate
+ * @return Pointer to the allocated memory, or NULL if allocation failed
+ */
+static void *acc_driver_os_mem_alloc(size_t size)
+{
+	if (!mem_accounting) {
+		void *ptr = acc_driver_os_linux_arena_alloc(size);
+
+		return (ptr != NULL) ? ptr : base_mem_alloc(size);
+	}
+
+	if (size == 0 || size > UINT32_MAX - sizeof(mem_header_t)) {
+		return NULL;
+	}
+
+	mem_header_t *header = acc_driver_os_linux_arena_alloc(sizeof(mem_header_t) + size);
+
+	if (header == NULL) {
+		header = base_mem_alloc(sizeof(mem_header_t) + size);
+		if (header == NULL) {
+			return NULL;
+		}
+	}
+
+	header->accounting.size = size;
+	header->accounting.site = acc_driver_os_linux_mem_accounting_alloc(__builtin_return_address(0), size);
+
+	return header + 1;
+}
+
+
+/**
+ * @brief Free dynamic memory, arena memory is released when its scope is closed
+ *
+ * @param ptr Pointer to the dynamic memory to free
+ */
+static void acc_driver_os_mem_free(void *ptr)
+{
+	if (mem_accounting && ptr != NULL) {
+		mem_header_t *header = (mem_header_t *)ptr - 1;
+
+		acc_driver_os_linux_mem_accounting_free(header->accounting.site, header->accounting.size);
+		ptr = header;
+	}
+
+	if (!acc_driver_os_linux_arena_free(ptr)) {
+		base_mem_free(ptr);
+	}
+}
+
+
+/**
+ * @brief Allocate an object of the driver, such as a mutex or a thread handle
+ *
+ * The objects are often created on first use, inside an arena scope of the caller, and live on after
+ * the scope is closed. They are allocated outside the arena and are not counted by heap accounting.
+ *
+ * @param size The number of bytes to allocate
+ * @return Pointer to the allocated memory, or NULL if allocation failed
+ */
+static void *os_object_alloc(size_t size)
+{
+	return base_mem_alloc(size);
+}
+
+
+/**
+ * @brief Free an object allocated with os_object_alloc()
+ *
+ * @param ptr Pointer to the object
+ */
+static void os_object_free(void *ptr)
+{
+	base_mem_free(ptr);
+}
+
+
 /**
  * @brief Return the unique thread ID for the current thread
  */
@@ -184,6 +435,17 @@ static acc_os_thread_id_t acc_driver_os_get_thread_id(void)
 }
 
 
+/**
+ * @brief The local time of the second that acc_driver_os_localtime() last converted on this thread
+ *
+ * Log messages ask for the time many times per second, and localtime_r() takes the time zone lock
+ * and may check the time zone files each time. The broken-down time only changes with the second.
+ */
+static __thread bool		localtime_cached = false;
+static __thread time_t		localtime_cached_sec;
+static __thread struct tm	localtime_cached_tm;
+
+
 /**
  * @brief Calculate current time and return in a struct tm, and optionally with microseconds
  *
@@ -198,9 +460,19 @@ static void acc_driver_os_localtime(struct tm *time_tm, uint32_t *time_usec)
 	if (result != 0) {
 		ACC_LOG_ERROR("gettimeofday returned %d %d %s", result, errno, strerror(errno));
 	}
-	if (localtime_r(&time_tv.tv_sec, time_tm) == NULL) {
-		ACC_LOG_ERROR("localtime_r return NULL");
+
+	if (!localtime_cached || time_tv.tv_sec != localtime_cached_sec) {
+		if (localtime_r(&time_tv.tv_sec, &localtime_cached_tm) == NULL) {
+			localtime_cached = false;
+			ACC_LOG_ERROR("localtime_r return NULL");
+		} else {
+			localtime_cached	= true;
+			localtime_cached_sec	= time_tv.tv_sec;
+		}
 	}
+
+	*time_tm = localtime_cached_tm;
+
 	if (time_usec)
 		*time_usec = time_tv.tv_usec;
 }
@@ -213,7 +485,7 @@ static void acc_driver_os_localtime(struct tm *time_tm, uint32_t *time_usec)
  */
 static acc_os_mutex_t acc_driver_os_mutex_create(void)
 {
-	acc_os_mutex_t mutex = acc_os_mem_alloc(sizeof(*mutex));
+	acc_os_mutex_t mutex = os_object_alloc(sizeof(*mutex));
 
 	if (mutex != NULL) {
 		pthread_mutex_init(&mutex->mutex, NULL);
@@ -227,7 +499,7 @@ static acc_os_mutex_t acc_driver_os_mutex_create(void)
 static void acc_driver_os_mutex_destroy(acc_os_mutex_t mutex)
 {
 	pthread_mutex_destroy(&mutex->mutex);
-	acc_os_mem_free(mutex);
+	os_object_free(mutex);
 }
 
 
@@ -253,30 +525,393 @@ static void acc_driver_os_mutex_unlock(acc_os_mutex_t mutex)
 }
 
 
+/**
+ * @brief Create a futex backed mutex
+ *
+ * @return Newly initialized mutex
+ */
+static acc_os_mutex_t acc_driver_os_futex_mutex_create(void)
+{
+	acc_os_mutex_t mutex = os_object_alloc(sizeof(*mutex));
+
+	if (mutex != NULL) {
+		acc_driver_os_linux_futex_mutex_init(&mutex->futex_mutex);
+		mutex->is_initialized = 1;
+	}
+
+	return mutex;
+}
+
+
+static void acc_driver_os_futex_mutex_destroy(acc_os_mutex_t mutex)
+{
+	os_object_free(mutex);
+}
+
+
+static void acc_driver_os_futex_mutex_lock(acc_os_mutex_t mutex)
+{
+	acc_driver_os_linux_futex_mutex_lock(&mutex->futex_mutex);
+}
+
+
+static void acc_driver_os_futex_mutex_unlock(acc_os_mutex_t mutex)
+{
+	acc_driver_os_linux_futex_mutex_unlock(&mutex->futex_mutex);
+}
+
+
+/**
+ * @brief Start routine of all threads, calls the thread function with the pthread signature
+ *
+ * @param arg The handle of the thread
+ * @return Always NULL
+ */
+static void *thread_start(void *arg)
+{
+	acc_os_thread_handle_t thread = arg;
+
+	current_thread = thread;
+	thread->func(thread->param);
+
+	return NULL;
+}
+
+
+/**
+ * @brief Apply thread attributes to pthread attributes
+ *
+ * @param attributes The thread attributes
+ * @param[out] attr The pthread attributes, initialized
+ * @param real_time True to apply the real time priority
+ * @return True if all attributes could be applied
+ */
+static bool thread_attr_init(const acc_driver_os_linux_thread_attributes_t *attributes, pthread_attr_t *attr, bool real_time)
+{
+	int ret = pthread_attr_init(attr);
+
+	if (ret != 0) {
+		ACC_LOG_ERROR("pthread_attr_init: %s", strerror(ret));
+		return false;
+	}
+
+	if (attributes->stack_size != 0) {
+		size_t stack_size = (attributes->stack_size < (size_t)PTHREAD_STACK_MIN) ? (size_t)PTHREAD_STACK_MIN : attributes->stack_size;
+
+		ret = pthread_attr_setstacksize(attr, stack_size);
+		if (ret != 0) {
+			ACC_LOG_ERROR("Invalid thread stack size %u: %s", (unsigned int)stack_size, strerror(ret));
+			pthread_attr_destroy(attr);
+			return false;
+		}
+	}
+
+	if (real_time && attributes->priority > 0) {
+		struct sched_param sched = { .sched_priority = attributes->priority };
+
+		pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(attr, SCHED_FIFO);
+		ret = pthread_attr_setschedparam(attr, &sched);
+		if (ret != 0) {
+			ACC_LOG_ERROR("Invalid thread priority %d: %s", (int)attributes->priority, strerror(ret));
+			pthread_attr_destroy(attr);
+			return false;
+		}
+	}
+
+	if (attributes->cpu_mask != 0) {
+		cpu_set_t cpus;
+
+		CPU_ZERO(&cpus);
+		for (uint_fast8_t cpu = 0; cpu < 32; cpu++) {
+			if (attributes->cpu_mask & (1u << cpu)) {
+				CPU_SET(cpu, &cpus);
+			}
+		}
+
+		ret = pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus);
+		if (ret != 0) {
+			ACC_LOG_ERROR("Invalid thread CPU mask 0x%x: %s", (unsigned int)attributes->cpu_mask, strerror(ret));
+			pthread_attr_destroy(attr);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Give a thread with stack tracking a stack mapped by the driver
+ *
+ * The stack has the size that the pthread attributes ask for, and is mapped on the first call only.
+ * Pages are locked as the thread faults them in, so that a swapped out page does not hide stack
+ * usage. If the lock is not permitted, the stack is used without it.
+ *
+ * @param thread The thread
+ * @param attr The pthread attributes
+ * @return True if the stack could be set
+ */
+static bool thread_attr_set_stack(acc_os_thread_handle_t thread, pthread_attr_t *attr)
+{
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+	if (thread->stack_mapping == NULL) {
+		size_t stack_size;
+
+		pthread_attr_getstacksize(attr, &stack_size);
+		stack_size = (stack_size + page_size - 1) & ~(page_size - 1);
+
+		void *mapping = mmap(NULL, stack_size + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+		if (mapping == MAP_FAILED) {
+			ACC_LOG_ERROR("Unable to map thread stack of %u bytes: %s", (unsigned int)stack_size, strerror(errno));
+			return false;
+		}
+
+		// The lowest page catches a stack overflow, like the guard page of the C library
+		if (mprotect(mapping, page_size, PROT_NONE) != 0) {
+			ACC_LOG_ERROR("Unable to protect thread stack guard page: %s", strerror(errno));
+			munmap(mapping, stack_size + page_size);
+			return false;
+		}
+
+#if defined(SYS_mlock2)
+		if (syscall(SYS_mlock2, (uint8_t *)mapping + page_size, stack_size, MLOCK_ONFAULT) != 0) {
+			ACC_LOG_VERBOSE("Thread stack not locked, usage of swapped out pages is not counted: %s", strerror(errno));
+		}
+#endif
+
+		thread->stack_mapping		= mapping;
+		thread->stack_mapping_size	= stack_size + page_size;
+	}
+
+	int ret = pthread_attr_setstack(attr, thread->stack_mapping + page_size, thread->stack_mapping_size - page_size);
+
+	if (ret != 0) {
+		ACC_LOG_ERROR("pthread_attr_setstack: %s", strerror(ret));
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Release the stack of a thread with stack tracking, keeping its high-water mark in the stack report
+ *
+ * @param thread The thread, terminated
+ */
+static void thread_release_stack(acc_os_thread_handle_t thread)
+{
+	if (thread->stack_mapping == NULL) {
+		return;
+	}
+
+	if (thread->stack_record >= 0) {
+		size_t usage = acc_driver_os_linux_thread_get_stack_usage(thread);
+
+		pthread_mutex_lock(&stack_records_mutex);
+		stack_record_t *record = &stack_records[thread->stack_record];
+
+		if (usage > record->peak_usage) {
+			record->peak_usage = usage;
+		}
+		record->thread = NULL;
+		pthread_mutex_unlock(&stack_records_mutex);
+	}
+
+	munmap(thread->stack_mapping, thread->stack_mapping_size);
+	thread->stack_mapping = NULL;
+}
+
+
+/**
+ * @brief List a thread with stack tracking in the stack report
+ *
+ * @param thread The thread
+ * @param name The name of the thread
+ */
+static void stack_record_add(acc_os_thread_handle_t thread, const char *name)
+{
+	stack_record_t *free_record = NULL;
+
+	pthread_mutex_lock(&stack_records_mutex);
+
+	for (uint_fast8_t index = 0; index < STACK_RECORD_COUNT_MAX; index++) {
+		stack_record_t *record = &stack_records[index];
+
+		if (!record->in_use) {
+			if (free_record == NULL) {
+				free_record = record;
+			}
+		} else if (record->thread == NULL && strcmp(record->name, name) == 0) {
+			free_record = record;
+			break;
+		}
+	}
+
+	if (free_record != NULL) {
+		if (!free_record->in_use) {
+			memset(free_record, 0, sizeof(*free_record));
+			snprintf(free_record->name, sizeof(free_record->name), "%s", name);
+			free_record->in_use = true;
+		}
+
+		free_record->stack_size	= thread->stack_mapping_size - (size_t)sysconf(_SC_PAGESIZE);
+		free_record->thread	= thread;
+		thread->stack_record	= (int_fast8_t)(free_record - stack_records);
+	}
+
+	pthread_mutex_unlock(&stack_records_mutex);
+}
+
+
+acc_os_thread_handle_t acc_driver_os_linux_thread_create_ex(void (*func)(void *param), void *param,
+                                                            const acc_driver_os_linux_thread_attributes_t *attributes)
+{
+	pthread_attr_t	attr;
+	int		ret;
+
+	acc_os_thread_handle_t thread = os_object_alloc(sizeof(*thread));
+
+	if (thread == NULL) {
+		return NULL;
+	}
+
+	thread->func			= func;
+	thread->param			= param;
+	thread->stack_mapping		= NULL;
+	thread->stack_mapping_size	= 0;
+	thread->stack_record		= -1;
+
+	if (!thread_attr_init(attributes, &attr, true)) {
+		os_object_free(thread);
+		return NULL;
+	}
+
+	if (attributes->stack_tracking && !thread_attr_set_stack(thread, &attr)) {
+		pthread_attr_destroy(&attr);
+		thread_release_stack(thread);
+		os_object_free(thread);
+		return NULL;
+	}
+
+	ret = pthread_create(&thread->handle, &attr, thread_start, thread);
+	pthread_attr_destroy(&attr);
+
+	if (ret == EPERM && attributes->priority > 0) {
+		// Real time scheduling needs CAP_SYS_NICE or an rtprio limit, run with normal scheduling instead
+		ACC_LOG_WARNING("Not permitted to use real time priority %d, using default scheduling", (int)attributes->priority);
+
+		if (!thread_attr_init(attributes, &attr, false)) {
+			thread_release_stack(thread);
+			os_object_free(thread);
+			return NULL;
+		}
+
+		if (attributes->stack_tracking && !thread_attr_set_stack(thread, &attr)) {
+			pthread_attr_destroy(&attr);
+			thread_release_stack(thread);
+			os_object_free(thread);
+			return NULL;
+		}
+
+		ret = pthread_create(&thread->handle, &attr, thread_start, thread);
+		pthread_attr_destroy(&attr);
+	}
+
+	if (ret != 0) {
+		ACC_LOG_ERROR("%s: Error %d, %s", __func__, ret, strerror(ret));
+		thread_release_stack(thread);
+		os_object_free(thread);
+		return NULL;
+	}
+
+	// The kernel limits thread names to 15 characters
+	char name[16] = "";
+
+	if (attributes->name != NULL) {
+		snprintf(name, sizeof(name), "%s", attributes->name);
+		pthread_setname_np(thread->handle, name);
+	}
+
+	if (thread->stack_mapping != NULL) {
+		stack_record_add(thread, name);
+	}
+
+	ACC_LOG_VERBOSE("%s: created thread_handle=%lu", __func__, (unsigned long)thread->handle);
+	return thread;
+}
+
+
 /**
  * @brief Create new thread
  *
+ * The thread gets the attributes set by acc_driver_os_linux_set_thread_attributes().
+ *
  * @param func	Function implementing the thread code
  * @param param	Parameter to be passed to the thread function
  * @return Newly created thread
  */
 static acc_os_thread_handle_t acc_driver_os_thread_create(void (*func)(void *param), void *param)
 {
-	int	ret;
+	return acc_driver_os_linux_thread_create_ex(func, param, &thread_attributes);
+}
 
-	acc_os_thread_handle_t thread = acc_os_mem_alloc(sizeof(*thread));
 
-	if (thread != NULL) {
-		// TODO the function cast should be replaced by something safer
-		ret = pthread_create(&thread->handle, NULL, (void* (*)(void*))func, param);
-		if (ret != 0) {
-			ACC_LOG_ERROR("%s: Error %d, %s", __func__, ret, strerror(ret));
-			return thread;
+void acc_driver_os_linux_set_thread_attributes(const acc_driver_os_linux_thread_attributes_t *attributes)
+{
+	thread_attributes = *attributes;
+}
+
+
+void acc_driver_os_linux_get_thread_attributes(acc_driver_os_linux_thread_attributes_t *attributes)
+{
+	*attributes = thread_attributes;
+}
+
+
+size_t acc_driver_os_linux_thread_get_stack_usage(acc_os_thread_handle_t thread)
+{
+	if (thread->stack_mapping == NULL) {
+		return 0;
+	}
+
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+	return stack_high_water(thread->stack_mapping + page_size, thread->stack_mapping_size - page_size);
+}
+
+
+void acc_driver_os_linux_print_stack_report(FILE *file)
+{
+	fprintf(file, "thread           size       peak       state\n");
+
+	pthread_mutex_lock(&stack_records_mutex);
+
+	for (uint_fast8_t index = 0; index < STACK_RECORD_COUNT_MAX; index++) {
+		stack_record_t *record = &stack_records[index];
+
+		if (!record->in_use) {
+			continue;
+		}
+
+		size_t peak_usage = record->peak_usage;
+
+		if (record->thread != NULL) {
+			size_t usage = acc_driver_os_linux_thread_get_stack_usage(record->thread);
+
+			if (usage > peak_usage) {
+				peak_usage = usage;
+			}
 		}
+
+		fprintf(file, "%-16s %-10u %-10u %s\n", (record->name[0] != '\0') ? record->name : "?", (unsigned int)record->stack_size,
+		        (unsigned int)peak_usage, (record->thread != NULL) ? "running" : "exited");
 	}
 
-	ACC_LOG_VERBOSE("%s: created thread_handle=%lu", __func__, (unsigned long)thread->handle);
-	return thread;
+	pthread_mutex_unlock(&stack_records_mutex);
 }
 
 
@@ -310,7 +945,8 @@ static bool acc_driver_os_thread_cleanup(acc_os_thread_handle_t thread)
 		return false;
 	}
 
-	acc_os_mem_free(thread);
+	thread_release_stack(thread);
+	os_object_free(thread);
 	return true;
 }
 
@@ -462,7 +1098,7 @@ static void acc_driver_os_net_disconnect(acc_os_socket_t sock)
 
 static acc_os_socket_t acc_driver_os_net_connect(acc_os_net_address_t address, acc_os_net_port_t port)
 {
-	acc_os_socket_t	sock = acc_os_mem_alloc(sizeof(*sock));
+	acc_os_socket_t	sock = os_object_alloc(sizeof(*sock));
 
 	if (sock == NULL) {
 		return NULL;
@@ -640,12 +1276,10 @@ static acc_os_semaphore_t acc_driver_os_semaphore_create(void)
 {
 	acc_os_semaphore_t sem = NULL;
 
-	sem = acc_os_mem_alloc(sizeof(*sem));
+	sem = os_object_alloc(sizeof(*sem));
 
 	if (sem != NULL) {
-		if (sem_init(&sem->handle, 0, 0) == -1) {
-			return NULL;
-		}
+		acc_driver_os_linux_futex_semaphore_init(&sem->semaphore, 0);
 		sem->is_initialized	= 1;
 	}
 
@@ -653,40 +1287,17 @@ static acc_os_semaphore_t acc_driver_os_semaphore_create(void)
 }
 
 
-static int_fast8_t acc_driver_os_semaphore_wait(acc_os_semaphore_t sem, uint_fast16_t timeout_ms)
+int_fast8_t acc_driver_os_linux_semaphore_wait_us(acc_os_semaphore_t sem, uint32_t timeout_us)
 {
-	struct timespec ts;
-	struct timeval tv;
-
 	if (sem == NULL || sem->is_initialized != 1) {
 		ACC_LOG_ERROR("Not valid semaphore");
 		return -1;
 	}
 
-	int result = gettimeofday(&tv, NULL);
-	if (result != 0) {
-		ACC_LOG_ERROR("gettimeofday returned %d %d %s", result, errno, strerror(errno));
-		return -1;
-	}
-
-	ts.tv_sec = tv.tv_sec;
-	ts.tv_nsec = tv.tv_usec + (timeout_ms * 1000);
-
-	while (ts.tv_nsec >= 1000000) {
-		ts.tv_sec++;
-		ts.tv_nsec -= 1000000;
-	}
-	ts.tv_nsec *= 1000;
-
-	if (sem_timedwait(&(sem->handle), &ts) == -1) {
-		/* Timeout */
-		if (errno == ETIMEDOUT) {
-			if (timeout_ms != 0) {
-				ACC_LOG_DEBUG("Semaphore timeout");
-			}
-			return -1;
+	if (!acc_driver_os_linux_futex_semaphore_wait(&sem->semaphore, timeout_us)) {
+		if (timeout_us != 0) {
+			ACC_LOG_DEBUG("Semaphore timeout");
 		}
-		ACC_LOG_ERROR("An error has occurred: %d", errno);
 		return -1;
 	}
 
@@ -694,10 +1305,16 @@ static int_fast8_t acc_driver_os_semaphore_wait(acc_os_semaphore_t sem, uint_fas
 }
 
 
+static int_fast8_t acc_driver_os_semaphore_wait(acc_os_semaphore_t sem, uint_fast16_t timeout_ms)
+{
+	return acc_driver_os_linux_semaphore_wait_us(sem, (uint32_t)timeout_ms * 1000);
+}
+
+
 static void acc_driver_os_semaphore_signal(acc_os_semaphore_t sem)
 {
 	if (sem != NULL && sem->is_initialized) {
-		sem_post(&sem->handle);
+		acc_driver_os_linux_futex_semaphore_signal(&sem->semaphore);
 	}
 }
 
@@ -711,9 +1328,7 @@ static void acc_driver_os_semaphore_signal_from_interrupt(acc_os_semaphore_t sem
 static void acc_driver_os_semaphore_destroy(acc_os_semaphore_t sem)
 {
 	if (sem != NULL && sem->is_initialized) {
-		sem_destroy(&sem->handle);
-
-		acc_os_mem_free(sem);
+		os_object_free(sem);
 	}
 }
 
@@ -742,20 +1357,77 @@ static uint32_t acc_driver_os_htonl(uint32_t value)
 }
 
 
+bool acc_driver_os_linux_set_allocator(acc_driver_os_linux_allocator_t selected_allocator)
+{
+	if (registered) {
+		ACC_LOG_WARNING("Allocator must be selected before the OS driver is registered");
+		return false;
+	}
+
+	allocator = selected_allocator;
+
+	return true;
+}
+
+
+bool acc_driver_os_linux_set_futex_mutex(bool enable)
+{
+	if (registered) {
+		ACC_LOG_WARNING("Mutex type must be selected before the OS driver is registered");
+		return false;
+	}
+
+	futex_mutex = enable;
+
+	return true;
+}
+
+
+bool acc_driver_os_linux_set_mem_accounting(bool enable)
+{
+	if (registered) {
+		ACC_LOG_WARNING("Heap accounting must be selected before the OS driver is registered");
+		return false;
+	}
+
+	mem_accounting = enable;
+
+	return true;
+}
+
+
 void acc_driver_os_linux_register(void)
 {
 	acc_device_os_init_func					= acc_driver_os_init;
 	acc_device_os_stack_setup_func				= acc_driver_os_stack_setup;
 	acc_device_os_stack_get_usage_func			= acc_driver_os_stack_get_usage;
 	acc_device_os_sleep_us_func				= acc_driver_os_sleep_us;
-	acc_device_os_get_mem_alloc_func			= malloc;
-	acc_device_os_get_mem_free_func				= free;
+	switch (allocator) {
+		case ACC_DRIVER_OS_LINUX_ALLOCATOR_POOL:
+			base_mem_alloc	= acc_driver_os_linux_pool_alloc;
+			base_mem_free	= acc_driver_os_linux_pool_free;
+			break;
+		default:
+			base_mem_alloc	= malloc;
+			base_mem_free	= free;
+			break;
+	}
+
+	acc_device_os_get_mem_alloc_func			= acc_driver_os_mem_alloc;
+	acc_device_os_get_mem_free_func				= acc_driver_os_mem_free;
 	acc_device_os_get_thread_id_func			= acc_driver_os_get_thread_id;
 	acc_device_os_localtime_func				= acc_driver_os_localtime;
-	acc_device_os_mutex_create_func				= acc_driver_os_mutex_create;
-	acc_device_os_mutex_lock_func				= acc_driver_os_mutex_lock;
-	acc_device_os_mutex_unlock_func				= acc_driver_os_mutex_unlock;
-	acc_device_os_mutex_destroy_func			= acc_driver_os_mutex_destroy;
+	if (futex_mutex) {
+		acc_device_os_mutex_create_func			= acc_driver_os_futex_mutex_create;
+		acc_device_os_mutex_lock_func			= acc_driver_os_futex_mutex_lock;
+		acc_device_os_mutex_unlock_func			= acc_driver_os_futex_mutex_unlock;
+		acc_device_os_mutex_destroy_func		= acc_driver_os_futex_mutex_destroy;
+	} else {
+		acc_device_os_mutex_create_func			= acc_driver_os_mutex_create;
+		acc_device_os_mutex_lock_func			= acc_driver_os_mutex_lock;
+		acc_device_os_mutex_unlock_func			= acc_driver_os_mutex_unlock;
+		acc_device_os_mutex_destroy_func		= acc_driver_os_mutex_destroy;
+	}
 	acc_device_os_thread_create_func			= acc_driver_os_thread_create;
 	acc_device_os_thread_delete_func			= acc_driver_os_thread_delete;
 	acc_device_os_thread_cleanup_func			= acc_driver_os_thread_cleanup;
@@ -780,4 +1452,6 @@ void acc_driver_os_linux_register(void)
 	acc_device_os_htons_func				= acc_driver_os_htons;
 	acc_device_os_ntohl_func				= acc_driver_os_ntohl;
 	acc_device_os_htonl_func				= acc_driver_os_htonl;
+
+	registered = true;
 }
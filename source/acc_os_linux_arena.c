@@ -0,0 +1,181 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "acc_log.h"
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief The module name
+ */
+#define MODULE "os_arena"
+
+/**
+ * @brief Alignment of arena allocations, the largest natural alignment on the target
+ */
+#define ARENA_ALIGNMENT		(8)
+
+/**
+ * @brief Maximum number of arenas that can exist at the same time
+ */
+#define ARENA_COUNT_MAX		(8)
+
+
+struct acc_driver_os_linux_arena_s {
+	uint8_t		*memory;
+	size_t		capacity;
+	size_t		used;
+	size_t		peak;
+	uint32_t	overflows;	/**< Allocations passed on because the arena was full */
+	bool		in_scope;
+};
+
+
+/**
+ * @brief All existing arenas, to recognize arena memory when it is freed
+ */
+static acc_driver_os_linux_arena_t		arenas[ARENA_COUNT_MAX];
+static uint32_t					arena_count = 0;
+
+/**
+ * @brief The arena of the scope open on the calling thread, NULL if none
+ */
+static __thread acc_driver_os_linux_arena_t	scope_arena = NULL;
+
+
+acc_driver_os_linux_arena_t acc_driver_os_linux_arena_create(size_t capacity)
+{
+	acc_driver_os_linux_arena_t arena = calloc(1, sizeof(*arena));
+
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	arena->memory = malloc(capacity);
+	if (arena->memory == NULL) {
+		free(arena);
+		return NULL;
+	}
+
+	arena->capacity = capacity;
+
+	for (uint_fast8_t index = 0; index < ARENA_COUNT_MAX; index++) {
+		acc_driver_os_linux_arena_t expected = NULL;
+
+		if (__atomic_compare_exchange_n(&arenas[index], &expected, arena, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+			__atomic_fetch_add(&arena_count, 1, __ATOMIC_RELEASE);
+			return arena;
+		}
+	}
+
+	ACC_LOG_ERROR("Too many arenas, max %u", (unsigned int)ARENA_COUNT_MAX);
+	free(arena->memory);
+	free(arena);
+
+	return NULL;
+}
+
+
+void acc_driver_os_linux_arena_destroy(acc_driver_os_linux_arena_t *arena)
+{
+	if (arena == NULL || *arena == NULL) {
+		return;
+	}
+
+	for (uint_fast8_t index = 0; index < ARENA_COUNT_MAX; index++) {
+		if (__atomic_load_n(&arenas[index], __ATOMIC_RELAXED) == *arena) {
+			__atomic_store_n(&arenas[index], NULL, __ATOMIC_RELEASE);
+			__atomic_fetch_sub(&arena_count, 1, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+
+	free((*arena)->memory);
+	free(*arena);
+	*arena = NULL;
+}
+
+
+bool acc_driver_os_linux_arena_scope_begin(acc_driver_os_linux_arena_t arena)
+{
+	// The arena is claimed atomically, as two threads may try to open a scope on it at the same time
+	if (scope_arena != NULL || __atomic_exchange_n(&arena->in_scope, true, __ATOMIC_ACQUIRE)) {
+		ACC_LOG_ERROR("Arena scopes can not be nested or shared between threads");
+		return false;
+	}
+
+	arena->used	= 0;
+	scope_arena	= arena;
+
+	return true;
+}
+
+
+void acc_driver_os_linux_arena_scope_end(void)
+{
+	if (scope_arena == NULL) {
+		return;
+	}
+
+	scope_arena->used	= 0;
+	__atomic_store_n(&scope_arena->in_scope, false, __ATOMIC_RELEASE);
+	scope_arena		= NULL;
+}
+
+
+void acc_driver_os_linux_arena_get_stats(acc_driver_os_linux_arena_t arena, acc_driver_os_linux_arena_stats_t *stats)
+{
+	stats->capacity		= arena->capacity;
+	stats->used		= arena->used;
+	stats->peak		= arena->peak;
+	stats->overflows	= arena->overflows;
+}
+
+
+void *acc_driver_os_linux_arena_alloc(size_t size)
+{
+	acc_driver_os_linux_arena_t arena = scope_arena;
+
+	if (arena == NULL || size == 0) {
+		return NULL;
+	}
+
+	size_t aligned_size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+	if (aligned_size < size || aligned_size > arena->capacity - arena->used) {
+		arena->overflows++;
+		return NULL;
+	}
+
+	void *ptr = &arena->memory[arena->used];
+
+	arena->used += aligned_size;
+	if (arena->used > arena->peak) {
+		arena->peak = arena->used;
+	}
+
+	return ptr;
+}
+
+
+bool acc_driver_os_linux_arena_free(void *ptr)
+{
+	if (ptr == NULL || __atomic_load_n(&arena_count, __ATOMIC_ACQUIRE) == 0) {
+		return false;
+	}
+
+	for (uint_fast8_t index = 0; index < ARENA_COUNT_MAX; index++) {
+		acc_driver_os_linux_arena_t arena = __atomic_load_n(&arenas[index], __ATOMIC_ACQUIRE);
+
+		if (arena != NULL && (uint8_t *)ptr >= arena->memory && (uint8_t *)ptr < arena->memory + arena->capacity) {
+			return true;
+		}
+	}
+
+	return false;
+}
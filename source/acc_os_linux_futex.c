@@ -0,0 +1,182 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+//needed for syscall
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief Number of times to retry a contended mutex before sleeping in the kernel
+ *
+ * Critical sections in the drivers are a few hundred instructions at most, so the owner is
+ * likely to release the mutex while spinning if it is running on another core.
+ */
+#define FUTEX_MUTEX_SPIN_COUNT	(100)
+
+/**
+ * @brief Mutex states
+ */
+/**@{*/
+#define FUTEX_MUTEX_UNLOCKED	(0)
+#define FUTEX_MUTEX_LOCKED	(1)	/**< Locked, no thread waiting in the kernel */
+#define FUTEX_MUTEX_CONTENDED	(2)	/**< Locked, threads may be waiting in the kernel */
+/**@}*/
+
+
+static long futex(uint32_t *address, int operation, uint32_t value)
+{
+	return syscall(SYS_futex, address, operation, value, NULL, NULL, 0);
+}
+
+
+/**
+ * @brief Wait while a futex has a value, until an absolute CLOCK_MONOTONIC deadline
+ */
+static long futex_wait_until(uint32_t *address, uint32_t value, const struct timespec *deadline)
+{
+	return syscall(SYS_futex, address, FUTEX_WAIT_BITSET_PRIVATE, value, deadline, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+
+/**
+ * @brief Hint to the CPU that the thread is spinning
+ */
+static void cpu_relax(void)
+{
+#if defined(__arm__) || defined(__aarch64__)
+	__asm__ __volatile__("yield" ::: "memory");
+#elif defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause" ::: "memory");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+
+static bool try_transition(uint32_t *state, uint32_t from, uint32_t to)
+{
+	return __atomic_compare_exchange_n(state, &from, to, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+
+void acc_driver_os_linux_futex_mutex_init(acc_driver_os_linux_futex_mutex_t *mutex)
+{
+	__atomic_store_n(&mutex->state, FUTEX_MUTEX_UNLOCKED, __ATOMIC_RELAXED);
+}
+
+
+bool acc_driver_os_linux_futex_mutex_trylock(acc_driver_os_linux_futex_mutex_t *mutex)
+{
+	return try_transition(&mutex->state, FUTEX_MUTEX_UNLOCKED, FUTEX_MUTEX_LOCKED);
+}
+
+
+void acc_driver_os_linux_futex_mutex_lock(acc_driver_os_linux_futex_mutex_t *mutex)
+{
+	if (try_transition(&mutex->state, FUTEX_MUTEX_UNLOCKED, FUTEX_MUTEX_LOCKED)) {
+		return;
+	}
+
+	for (uint_fast16_t spin = 0; spin < FUTEX_MUTEX_SPIN_COUNT; spin++) {
+		cpu_relax();
+
+		if (__atomic_load_n(&mutex->state, __ATOMIC_RELAXED) == FUTEX_MUTEX_UNLOCKED &&
+		    try_transition(&mutex->state, FUTEX_MUTEX_UNLOCKED, FUTEX_MUTEX_LOCKED)) {
+			return;
+		}
+	}
+
+	// Mark the mutex as contended so that the owner wakes a waiter on unlock
+	while (__atomic_exchange_n(&mutex->state, FUTEX_MUTEX_CONTENDED, __ATOMIC_ACQUIRE) != FUTEX_MUTEX_UNLOCKED) {
+		futex(&mutex->state, FUTEX_WAIT_PRIVATE, FUTEX_MUTEX_CONTENDED);
+	}
+}
+
+
+void acc_driver_os_linux_futex_mutex_unlock(acc_driver_os_linux_futex_mutex_t *mutex)
+{
+	if (__atomic_exchange_n(&mutex->state, FUTEX_MUTEX_UNLOCKED, __ATOMIC_RELEASE) == FUTEX_MUTEX_CONTENDED) {
+		futex(&mutex->state, FUTEX_WAKE_PRIVATE, 1);
+	}
+}
+
+
+void acc_driver_os_linux_futex_semaphore_init(acc_driver_os_linux_futex_semaphore_t *semaphore, uint32_t count)
+{
+	__atomic_store_n(&semaphore->count, count, __ATOMIC_RELAXED);
+	__atomic_store_n(&semaphore->waiters, 0, __ATOMIC_RELAXED);
+}
+
+
+static bool semaphore_try_decrement(acc_driver_os_linux_futex_semaphore_t *semaphore)
+{
+	uint32_t count = __atomic_load_n(&semaphore->count, __ATOMIC_RELAXED);
+
+	while (count > 0) {
+		if (__atomic_compare_exchange_n(&semaphore->count, &count, count - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool acc_driver_os_linux_futex_semaphore_wait(acc_driver_os_linux_futex_semaphore_t *semaphore, uint32_t timeout_us)
+{
+	if (semaphore_try_decrement(semaphore)) {
+		return true;
+	}
+
+	if (timeout_us == 0) {
+		return false;
+	}
+
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec		+= timeout_us / 1000000;
+	deadline.tv_nsec	+= (long)(timeout_us % 1000000) * 1000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	while (true) {
+		// A signal after the count was checked changes the count, which makes the wait return at once
+		__atomic_fetch_add(&semaphore->waiters, 1, __ATOMIC_SEQ_CST);
+		long result = futex_wait_until(&semaphore->count, 0, &deadline);
+		int  error = errno;
+		__atomic_fetch_sub(&semaphore->waiters, 1, __ATOMIC_RELAXED);
+
+		if (semaphore_try_decrement(semaphore)) {
+			return true;
+		}
+
+		if (result == -1 && error == ETIMEDOUT) {
+			return false;
+		}
+	}
+}
+
+
+void acc_driver_os_linux_futex_semaphore_signal(acc_driver_os_linux_futex_semaphore_t *semaphore)
+{
+	__atomic_fetch_add(&semaphore->count, 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&semaphore->waiters, __ATOMIC_SEQ_CST) > 0) {
+		futex(&semaphore->count, FUTEX_WAKE_PRIVATE, 1);
+	}
+}
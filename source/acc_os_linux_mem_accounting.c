@@ -0,0 +1,207 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+// needed for dladdr
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief Number of entries in the call site table, a power of two
+ */
+#define SITE_TABLE_SIZE		(ACC_DRIVER_OS_LINUX_MEM_SITE_COUNT_MAX)
+
+/**
+ * @brief Call site index used for all call sites when the table is full
+ */
+#define SITE_OTHER		(0)
+
+
+/**
+ * @brief Counters of one call site, or of all allocations
+ */
+typedef struct {
+	uintptr_t	address;
+	uint32_t	allocations;
+	uint32_t	frees;
+	size_t		current_bytes;
+	size_t		peak_bytes;
+} counters_t;
+
+
+static counters_t	totals;
+static counters_t	sites[SITE_TABLE_SIZE];
+
+/**
+ * @brief Allocation count and time of the previous rate measurement
+ */
+static pthread_mutex_t	rate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t		rate_allocations = 0;
+static uint64_t		rate_time_ns = 0;
+
+
+static void atomic_max_size(size_t *target, size_t value)
+{
+	size_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+
+	while (value > current && !__atomic_compare_exchange_n(target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+
+/**
+ * @brief Find or add the table entry of a call site
+ *
+ * @param address The call site
+ * @return Index of the entry, SITE_OTHER if the table is full
+ */
+static uint32_t site_lookup(uintptr_t address)
+{
+	uint32_t index = (uint32_t)(((address >> 2) * 2654435761u) & (SITE_TABLE_SIZE - 1));
+
+	for (uint32_t probe = 0; probe < SITE_TABLE_SIZE; probe++) {
+		if (index != SITE_OTHER) {
+			uintptr_t current = __atomic_load_n(&sites[index].address, __ATOMIC_ACQUIRE);
+
+			if (current == address) {
+				return index;
+			}
+
+			if (current == 0) {
+				if (__atomic_compare_exchange_n(&sites[index].address, &current, address, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+				    current == address) {
+					return index;
+				}
+			}
+		}
+
+		index = (index + 1) & (SITE_TABLE_SIZE - 1);
+	}
+
+	return SITE_OTHER;
+}
+
+
+static void counters_add(counters_t *counters, size_t size)
+{
+	__atomic_fetch_add(&counters->allocations, 1, __ATOMIC_RELAXED);
+	atomic_max_size(&counters->peak_bytes, __atomic_add_fetch(&counters->current_bytes, size, __ATOMIC_RELAXED));
+}
+
+
+static void counters_remove(counters_t *counters, size_t size)
+{
+	__atomic_fetch_add(&counters->frees, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&counters->current_bytes, size, __ATOMIC_RELAXED);
+}
+
+
+static void counters_read(const counters_t *counters, acc_driver_os_linux_mem_site_t *site)
+{
+	site->address		= (const void *)__atomic_load_n(&counters->address, __ATOMIC_ACQUIRE);
+	site->allocations	= __atomic_load_n(&counters->allocations, __ATOMIC_RELAXED);
+	site->frees		= __atomic_load_n(&counters->frees, __ATOMIC_RELAXED);
+	site->current_bytes	= __atomic_load_n(&counters->current_bytes, __ATOMIC_RELAXED);
+	site->peak_bytes	= __atomic_load_n(&counters->peak_bytes, __ATOMIC_RELAXED);
+}
+
+
+uint32_t acc_driver_os_linux_mem_accounting_alloc(const void *site, size_t size)
+{
+	uint32_t index = site_lookup((uintptr_t)site);
+
+	counters_add(&totals, size);
+	counters_add(&sites[index], size);
+
+	return index;
+}
+
+
+void acc_driver_os_linux_mem_accounting_free(uint32_t site, size_t size)
+{
+	counters_remove(&totals, size);
+	counters_remove(&sites[site & (SITE_TABLE_SIZE - 1)], size);
+}
+
+
+void acc_driver_os_linux_mem_get_stats(acc_driver_os_linux_mem_stats_t *stats)
+{
+	acc_driver_os_linux_mem_site_t total;
+
+	counters_read(&totals, &total);
+
+	stats->current_bytes	= total.current_bytes;
+	stats->peak_bytes	= total.peak_bytes;
+	stats->allocations	= total.allocations;
+	stats->frees		= total.frees;
+
+	uint64_t now_ns = acc_driver_os_linux_time_ns();
+
+	pthread_mutex_lock(&rate_mutex);
+	if (rate_time_ns != 0 && now_ns > rate_time_ns) {
+		stats->allocations_per_second = (total.allocations - rate_allocations) * 1e9f / (float)(now_ns - rate_time_ns);
+	} else {
+		stats->allocations_per_second = 0.0f;
+	}
+	rate_allocations	= total.allocations;
+	rate_time_ns		= now_ns;
+	pthread_mutex_unlock(&rate_mutex);
+}
+
+
+size_t acc_driver_os_linux_mem_get_sites(acc_driver_os_linux_mem_site_t *site_stats, size_t max_count)
+{
+	size_t count = 0;
+
+	for (uint32_t index = 0; index < SITE_TABLE_SIZE && count < max_count; index++) {
+		acc_driver_os_linux_mem_site_t site;
+
+		counters_read(&sites[index], &site);
+		if (site.allocations > 0) {
+			site_stats[count++] = site;
+		}
+	}
+
+	return count;
+}
+
+
+void acc_driver_os_linux_mem_print_report(FILE *file)
+{
+	acc_driver_os_linux_mem_stats_t	stats;
+	acc_driver_os_linux_mem_site_t	site_stats[SITE_TABLE_SIZE];
+
+	acc_driver_os_linux_mem_get_stats(&stats);
+
+	fprintf(file, "Heap: %u bytes in use, %u bytes peak, %u allocations, %u frees\n", (unsigned int)stats.current_bytes,
+	        (unsigned int)stats.peak_bytes, (unsigned int)stats.allocations, (unsigned int)stats.frees);
+	fprintf(file, "call site    current    peak       allocs     frees      symbol\n");
+
+	size_t count = acc_driver_os_linux_mem_get_sites(site_stats, SITE_TABLE_SIZE);
+
+	for (size_t index = 0; index < count; index++) {
+		acc_driver_os_linux_mem_site_t	*site = &site_stats[index];
+		Dl_info				info;
+		const char			*symbol = "?";
+
+		if (site->address == NULL) {
+			symbol = "(other call sites)";
+		} else if (dladdr((void *)site->address, &info) != 0 && info.dli_sname != NULL) {
+			symbol = info.dli_sname;
+		}
+
+		fprintf(file, "%-12p %-10u %-10u %-10u %-10u %s\n", (void *)site->address, (unsigned int)site->current_bytes,
+		        (unsigned int)site->peak_bytes, (unsigned int)site->allocations, (unsigned int)site->frees, symbol);
+	}
+}
@@ -0,0 +1,337 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief Size of the smallest block, each following size class doubles the block size
+ */
+#define POOL_BLOCK_SIZE_MIN	(16)
+
+/**
+ * @brief Size of the chunks of memory that are split into blocks of one size class
+ */
+#define POOL_SLAB_SIZE		(16384)
+
+/**
+ * @brief Maximum number of free blocks per size class kept by a thread
+ */
+#define POOL_CACHE_MAX		(64)
+
+/**
+ * @brief Number of blocks moved between a thread cache and the shared pool at a time
+ */
+#define POOL_CACHE_BATCH	(16)
+
+/**
+ * @brief Size class of allocations too large for the pool, they are passed on to malloc
+ */
+#define POOL_CLASS_LARGE	(ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT)
+
+
+/**
+ * @brief Header in front of every allocation, sized to keep the memory after it naturally aligned
+ */
+typedef union {
+	uint32_t	size_class;
+	uint64_t	align_u64;
+	double		align_double;
+	void		*align_pointer;
+} block_header_t;
+
+
+/**
+ * @brief A free block, the link is stored in the block itself
+ */
+typedef struct free_block {
+	struct free_block	*next;
+} free_block_t;
+
+
+/**
+ * @brief The shared pool of one size class
+ */
+typedef struct {
+	pthread_mutex_t	mutex;		/**< Protects free and blocks */
+	free_block_t	*free;
+	uint32_t	blocks;		/**< Number of blocks carved from slabs */
+	uint32_t	allocations;	/**< Updated atomically */
+	uint32_t	frees;		/**< Updated atomically */
+} pool_class_t;
+
+
+/**
+ * @brief The free blocks kept by one thread
+ */
+typedef struct {
+	free_block_t	*free[ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT];
+	uint_fast16_t	count[ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT];
+} thread_cache_t;
+
+
+#define POOL_CLASS_INIT { .mutex = PTHREAD_MUTEX_INITIALIZER }
+
+static pool_class_t		pool_classes[ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT] = {
+	POOL_CLASS_INIT, POOL_CLASS_INIT, POOL_CLASS_INIT, POOL_CLASS_INIT,
+	POOL_CLASS_INIT, POOL_CLASS_INIT, POOL_CLASS_INIT, POOL_CLASS_INIT
+};
+
+static uint32_t			large_allocations = 0;
+static uint32_t			large_frees = 0;
+static uint32_t			slab_count = 0;
+
+/**
+ * @brief Returns the cache of a thread to the shared pool when the thread exits
+ */
+static pthread_key_t		thread_cache_key;
+static pthread_once_t		thread_cache_key_once = PTHREAD_ONCE_INIT;
+
+static __thread thread_cache_t	thread_cache;
+static __thread bool		thread_cache_registered;
+
+
+static size_t class_block_size(uint_fast8_t size_class)
+{
+	return (size_t)POOL_BLOCK_SIZE_MIN << size_class;
+}
+
+
+/**
+ * @brief Get the size class of an allocation
+ *
+ * @param size The requested size
+ * @return The size class, POOL_CLASS_LARGE if the allocation is too large for the pool
+ */
+static uint_fast8_t size_to_class(size_t size)
+{
+	size_t		block_size = size + sizeof(block_header_t);
+	uint_fast8_t	size_class = 0;
+
+	while (size_class < POOL_CLASS_LARGE && class_block_size(size_class) < block_size) {
+		size_class++;
+	}
+
+	return size_class;
+}
+
+
+/**
+ * @brief Split a new slab into free blocks of a size class
+ *
+ * @param pool The shared pool of the size class, locked
+ * @param size_class The size class
+ * @return True if a slab could be allocated
+ */
+static bool carve_slab(pool_class_t *pool, uint_fast8_t size_class)
+{
+	size_t	block_size = class_block_size(size_class);
+	uint8_t	*slab = malloc(POOL_SLAB_SIZE);
+
+	if (slab == NULL) {
+		return false;
+	}
+
+	for (size_t offset = 0; offset + block_size <= POOL_SLAB_SIZE; offset += block_size) {
+		free_block_t *block = (free_block_t *)(void *)&slab[offset];
+
+		block->next = pool->free;
+		pool->free = block;
+		pool->blocks++;
+	}
+
+	__atomic_fetch_add(&slab_count, 1, __ATOMIC_RELAXED);
+
+	return true;
+}
+
+
+/**
+ * @brief Move a batch of free blocks from the shared pool to the thread cache
+ *
+ * @param size_class The size class
+ */
+static void cache_refill(uint_fast8_t size_class)
+{
+	pool_class_t *pool = &pool_classes[size_class];
+
+	pthread_mutex_lock(&pool->mutex);
+
+	for (uint_fast8_t count = 0; count < POOL_CACHE_BATCH; count++) {
+		if (pool->free == NULL && !carve_slab(pool, size_class)) {
+			break;
+		}
+
+		free_block_t *block = pool->free;
+
+		pool->free = block->next;
+		block->next = thread_cache.free[size_class];
+		thread_cache.free[size_class] = block;
+		thread_cache.count[size_class]++;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+
+/**
+ * @brief Move free blocks from a thread cache to the shared pool
+ *
+ * @param cache The thread cache
+ * @param size_class The size class
+ * @param keep Number of blocks to keep in the cache
+ */
+static void cache_flush(thread_cache_t *cache, uint_fast8_t size_class, uint_fast16_t keep)
+{
+	pool_class_t *pool = &pool_classes[size_class];
+
+	pthread_mutex_lock(&pool->mutex);
+
+	while (cache->count[size_class] > keep) {
+		free_block_t *block = cache->free[size_class];
+
+		cache->free[size_class] = block->next;
+		cache->count[size_class]--;
+		block->next = pool->free;
+		pool->free = block;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+
+static void thread_cache_destroy(void *param)
+{
+	thread_cache_t *cache = param;
+
+	for (uint_fast8_t size_class = 0; size_class < ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT; size_class++) {
+		cache_flush(cache, size_class, 0);
+	}
+}
+
+
+static void thread_cache_key_create(void)
+{
+	pthread_key_create(&thread_cache_key, thread_cache_destroy);
+}
+
+
+/**
+ * @brief Make sure the cache of the calling thread is returned to the shared pool when the thread exits
+ */
+static void thread_cache_register(void)
+{
+	pthread_once(&thread_cache_key_once, thread_cache_key_create);
+	pthread_setspecific(thread_cache_key, &thread_cache);
+	thread_cache_registered = true;
+}
+
+
+void *acc_driver_os_linux_pool_alloc(size_t size)
+{
+	if (size == 0) {
+		return NULL;
+	}
+
+	uint_fast8_t	size_class = size_to_class(size);
+	block_header_t	*header;
+
+	if (size_class == POOL_CLASS_LARGE) {
+		if (size > SIZE_MAX - sizeof(block_header_t)) {
+			return NULL;
+		}
+
+		header = malloc(sizeof(block_header_t) + size);
+		if (header == NULL) {
+			return NULL;
+		}
+
+		__atomic_fetch_add(&large_allocations, 1, __ATOMIC_RELAXED);
+	} else {
+		if (!thread_cache_registered) {
+			thread_cache_register();
+		}
+
+		if (thread_cache.free[size_class] == NULL) {
+			cache_refill(size_class);
+			if (thread_cache.free[size_class] == NULL) {
+				return NULL;
+			}
+		}
+
+		free_block_t *block = thread_cache.free[size_class];
+
+		thread_cache.free[size_class] = block->next;
+		thread_cache.count[size_class]--;
+
+		header = (block_header_t *)(void *)block;
+		__atomic_fetch_add(&pool_classes[size_class].allocations, 1, __ATOMIC_RELAXED);
+	}
+
+	header->size_class = size_class;
+
+	return header + 1;
+}
+
+
+void acc_driver_os_linux_pool_free(void *ptr)
+{
+	if (ptr == NULL) {
+		return;
+	}
+
+	block_header_t	*header = (block_header_t *)ptr - 1;
+	uint_fast8_t	size_class = header->size_class;
+
+	if (size_class == POOL_CLASS_LARGE) {
+		__atomic_fetch_add(&large_frees, 1, __ATOMIC_RELAXED);
+		free(header);
+		return;
+	}
+
+	if (!thread_cache_registered) {
+		thread_cache_register();
+	}
+
+	free_block_t *block = (free_block_t *)(void *)header;
+
+	block->next = thread_cache.free[size_class];
+	thread_cache.free[size_class] = block;
+	thread_cache.count[size_class]++;
+
+	__atomic_fetch_add(&pool_classes[size_class].frees, 1, __ATOMIC_RELAXED);
+
+	if (thread_cache.count[size_class] > POOL_CACHE_MAX) {
+		cache_flush(&thread_cache, size_class, POOL_CACHE_MAX - POOL_CACHE_BATCH);
+	}
+}
+
+
+void acc_driver_os_linux_pool_get_stats(acc_driver_os_linux_pool_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	for (uint_fast8_t size_class = 0; size_class < ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT; size_class++) {
+		pool_class_t				*pool = &pool_classes[size_class];
+		acc_driver_os_linux_pool_class_stats_t	*class_stats = &stats->classes[size_class];
+
+		class_stats->block_size		= class_block_size(size_class) - sizeof(block_header_t);
+		class_stats->allocations	= __atomic_load_n(&pool->allocations, __ATOMIC_RELAXED);
+		class_stats->frees		= __atomic_load_n(&pool->frees, __ATOMIC_RELAXED);
+
+		pthread_mutex_lock(&pool->mutex);
+		class_stats->blocks		= pool->blocks;
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	stats->large_allocations	= __atomic_load_n(&large_allocations, __ATOMIC_RELAXED);
+	stats->large_frees		= __atomic_load_n(&large_frees, __ATOMIC_RELAXED);
+	stats->slab_bytes		= (size_t)__atomic_load_n(&slab_count, __ATOMIC_RELAXED) * POOL_SLAB_SIZE;
+}
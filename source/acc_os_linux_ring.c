@@ -0,0 +1,268 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+// needed for posix_memalign
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "acc_log.h"
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief The module name
+ */
+#define MODULE "os_ring"
+
+/**
+ * @brief Cache line size of the targets, producer and consumer state are kept on separate lines
+ */
+#define RING_CACHE_LINE_SIZE	(64)
+
+/**
+ * @brief Largest ring capacity, a power of two
+ */
+#define RING_CAPACITY_MAX	(1u << 20)
+
+
+/**
+ * @brief A fixed capacity ring of fixed size elements
+ *
+ * For the multiple producer ring, each slot has a sequence number telling whether it is free for the
+ * producer at an index or holds the element for the consumer at an index.
+ */
+struct acc_driver_os_linux_ring_s {
+	// Set at creation, read only
+	acc_driver_os_linux_ring_type_t		type;
+	uint32_t				mask;
+	size_t					element_size;
+	uint8_t					*elements;
+	uint32_t				*sequences;
+
+	// Written by the producers
+	uint32_t				tail __attribute__((aligned(RING_CACHE_LINE_SIZE)));
+
+	// Written by the consumer
+	uint32_t				head __attribute__((aligned(RING_CACHE_LINE_SIZE)));
+	uint32_t				consumer_waiting;
+	acc_driver_os_linux_futex_semaphore_t	not_empty;
+};
+
+
+static uint8_t *slot(acc_driver_os_linux_ring_t ring, uint32_t index)
+{
+	return &ring->elements[(size_t)(index & ring->mask) * ring->element_size];
+}
+
+
+acc_driver_os_linux_ring_t acc_driver_os_linux_ring_create(acc_driver_os_linux_ring_type_t type, size_t element_size, uint32_t capacity)
+{
+	if (element_size == 0 || capacity == 0 || capacity > RING_CAPACITY_MAX) {
+		ACC_LOG_ERROR("Invalid ring element size %u or capacity %u", (unsigned int)element_size, (unsigned int)capacity);
+		return NULL;
+	}
+
+	uint32_t size = 1;
+
+	while (size < capacity) {
+		size <<= 1;
+	}
+
+	void *memory;
+
+	if (posix_memalign(&memory, RING_CACHE_LINE_SIZE, sizeof(struct acc_driver_os_linux_ring_s)) != 0) {
+		return NULL;
+	}
+
+	acc_driver_os_linux_ring_t ring = memory;
+
+	memset(ring, 0, sizeof(*ring));
+	ring->type		= type;
+	ring->mask		= size - 1;
+	ring->element_size	= element_size;
+	ring->elements		= malloc((size_t)size * element_size);
+
+	if (type == ACC_DRIVER_OS_LINUX_RING_MPSC) {
+		ring->sequences = malloc(size * sizeof(*ring->sequences));
+		if (ring->sequences != NULL) {
+			for (uint32_t index = 0; index < size; index++) {
+				ring->sequences[index] = index;
+			}
+		}
+	}
+
+	if (ring->elements == NULL || (type == ACC_DRIVER_OS_LINUX_RING_MPSC && ring->sequences == NULL)) {
+		acc_driver_os_linux_ring_destroy(&ring);
+		return NULL;
+	}
+
+	acc_driver_os_linux_futex_semaphore_init(&ring->not_empty, 0);
+
+	return ring;
+}
+
+
+void acc_driver_os_linux_ring_destroy(acc_driver_os_linux_ring_t *ring)
+{
+	if (ring == NULL || *ring == NULL) {
+		return;
+	}
+
+	free((*ring)->elements);
+	free((*ring)->sequences);
+	free(*ring);
+	*ring = NULL;
+}
+
+
+/**
+ * @brief Wake the consumer if it waits for an element
+ */
+static void consumer_wake(acc_driver_os_linux_ring_t ring)
+{
+	// Pairs with the fence in acc_driver_os_linux_ring_pop(), either the consumer sees the element or
+	// the producer sees the consumer waiting
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	// Only the first producer to see the consumer waiting signals, so signals do not pile up
+	if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_RELAXED) &&
+	    __atomic_exchange_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED)) {
+		acc_driver_os_linux_futex_semaphore_signal(&ring->not_empty);
+	}
+}
+
+
+static bool spsc_push(acc_driver_os_linux_ring_t ring, const void *element)
+{
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if (tail - head > ring->mask) {
+		return false;
+	}
+
+	memcpy(slot(ring, tail), element, ring->element_size);
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+
+static bool mpsc_push(acc_driver_os_linux_ring_t ring, const void *element)
+{
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+	while (true) {
+		uint32_t	sequence = __atomic_load_n(&ring->sequences[tail & ring->mask], __ATOMIC_ACQUIRE);
+		int32_t		difference = (int32_t)(sequence - tail);
+
+		if (difference == 0) {
+			// The slot is free, claim it by advancing the tail
+			if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (difference < 0) {
+			// The slot still holds the element from the previous lap, the ring is full
+			return false;
+		} else {
+			tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	memcpy(slot(ring, tail), element, ring->element_size);
+	__atomic_store_n(&ring->sequences[tail & ring->mask], tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+
+bool acc_driver_os_linux_ring_push(acc_driver_os_linux_ring_t ring, const void *element)
+{
+	bool pushed = (ring->type == ACC_DRIVER_OS_LINUX_RING_MPSC) ? mpsc_push(ring, element) : spsc_push(ring, element);
+
+	if (pushed) {
+		consumer_wake(ring);
+	}
+
+	return pushed;
+}
+
+
+static bool try_pop(acc_driver_os_linux_ring_t ring, void *element)
+{
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+	if (ring->type == ACC_DRIVER_OS_LINUX_RING_MPSC) {
+		if (__atomic_load_n(&ring->sequences[head & ring->mask], __ATOMIC_ACQUIRE) != head + 1) {
+			return false;
+		}
+
+		memcpy(element, slot(ring, head), ring->element_size);
+
+		// Free the slot for the producer one lap ahead
+		__atomic_store_n(&ring->sequences[head & ring->mask], head + ring->mask + 1, __ATOMIC_RELEASE);
+	} else {
+		if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+			return false;
+		}
+
+		memcpy(element, slot(ring, head), ring->element_size);
+	}
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+
+bool acc_driver_os_linux_ring_pop(acc_driver_os_linux_ring_t ring, void *element, uint32_t timeout_us)
+{
+	if (try_pop(ring, element)) {
+		return true;
+	}
+
+	if (timeout_us == 0) {
+		return false;
+	}
+
+	uint64_t deadline_ns = acc_driver_os_linux_time_ns() + (uint64_t)timeout_us * 1000;
+
+	while (true) {
+		__atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+		bool popped = try_pop(ring, element);
+
+		if (!popped) {
+			uint64_t now_ns = acc_driver_os_linux_time_ns();
+
+			if (now_ns < deadline_ns) {
+				// Signals left over from earlier pushes only cause another check of the ring
+				acc_driver_os_linux_futex_semaphore_wait(&ring->not_empty, (uint32_t)((deadline_ns - now_ns + 999) / 1000));
+			}
+
+			popped = try_pop(ring, element);
+			if (!popped && acc_driver_os_linux_time_ns() < deadline_ns) {
+				continue;
+			}
+		}
+
+		__atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+
+		return popped;
+	}
+}
+
+
+uint32_t acc_driver_os_linux_ring_get_count(acc_driver_os_linux_ring_t ring)
+{
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	return (tail - head > ring->mask + 1) ? ring->mask + 1 : tail - head;
+}
@@ -0,0 +1,275 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+//needed for syscall
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "acc_log.h"
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief The module name
+ */
+#define MODULE "os_task_pool"
+
+/**
+ * @brief Maximum number of worker threads
+ */
+#define TASK_POOL_WORKER_COUNT_MAX	(16)
+
+/**
+ * @brief Number of tasks each worker can queue, a power of two
+ */
+#define TASK_POOL_QUEUE_SIZE		(256)
+
+/**
+ * @brief Stack size of the worker threads
+ */
+#define TASK_POOL_STACK_SIZE		(256 * 1024)
+
+/**
+ * @brief Maximum time an idle worker sleeps before it looks for work again [us]
+ */
+#define TASK_POOL_IDLE_TIMEOUT_US	(1000000)
+
+
+typedef struct {
+	acc_driver_os_linux_task_t		func;
+	void					*param;
+	acc_driver_os_linux_task_group_t	*group;
+} task_t;
+
+
+/**
+ * @brief The task queue of one worker
+ *
+ * The owner pushes and pops at the tail, so it runs the task it queued most recently while its data
+ * is still in the cache. Other threads steal from the head, taking the oldest task.
+ */
+typedef struct {
+	acc_driver_os_linux_futex_mutex_t	mutex;
+	uint32_t				head;
+	uint32_t				tail;
+	task_t					tasks[TASK_POOL_QUEUE_SIZE];
+} queue_t;
+
+
+static queue_t					queues[TASK_POOL_WORKER_COUNT_MAX];
+static uint_fast8_t				worker_count = 0;
+static pthread_once_t				start_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Counts queued tasks, idle workers wait on it
+ */
+static acc_driver_os_linux_futex_semaphore_t	work_available;
+
+/**
+ * @brief Queue used for the next task submitted from a thread outside the pool
+ */
+static uint32_t					next_queue = 0;
+
+/**
+ * @brief Index of the worker running on this thread, -1 for threads outside the pool
+ */
+static __thread int_fast8_t			worker_index = -1;
+
+
+static long futex(uint32_t *address, int operation, uint32_t value)
+{
+	return syscall(SYS_futex, address, operation, value, NULL, NULL, 0);
+}
+
+
+static bool queue_push(queue_t *queue, const task_t *task)
+{
+	bool pushed = false;
+
+	acc_driver_os_linux_futex_mutex_lock(&queue->mutex);
+	if (queue->tail - queue->head < TASK_POOL_QUEUE_SIZE) {
+		queue->tasks[queue->tail % TASK_POOL_QUEUE_SIZE] = *task;
+		queue->tail++;
+		pushed = true;
+	}
+	acc_driver_os_linux_futex_mutex_unlock(&queue->mutex);
+
+	return pushed;
+}
+
+
+static bool queue_pop(queue_t *queue, task_t *task)
+{
+	bool popped = false;
+
+	acc_driver_os_linux_futex_mutex_lock(&queue->mutex);
+	if (queue->tail != queue->head) {
+		queue->tail--;
+		*task = queue->tasks[queue->tail % TASK_POOL_QUEUE_SIZE];
+		popped = true;
+	}
+	acc_driver_os_linux_futex_mutex_unlock(&queue->mutex);
+
+	return popped;
+}
+
+
+static bool queue_steal(queue_t *queue, task_t *task)
+{
+	bool stolen = false;
+
+	// A thief does not wait for a busy queue, it tries the next one
+	if (!acc_driver_os_linux_futex_mutex_trylock(&queue->mutex)) {
+		return false;
+	}
+
+	if (queue->tail != queue->head) {
+		*task = queue->tasks[queue->head % TASK_POOL_QUEUE_SIZE];
+		queue->head++;
+		stolen = true;
+	}
+	acc_driver_os_linux_futex_mutex_unlock(&queue->mutex);
+
+	return stolen;
+}
+
+
+/**
+ * @brief Take a task, from the own queue of a worker first and then from the other queues
+ *
+ * @param[out] task The task
+ * @return True if a task was taken
+ */
+static bool task_take(task_t *task)
+{
+	uint_fast8_t count = __atomic_load_n(&worker_count, __ATOMIC_ACQUIRE);
+	uint_fast8_t first = 0;
+
+	if (worker_index >= 0) {
+		if (queue_pop(&queues[worker_index], task)) {
+			return true;
+		}
+		first = worker_index + 1;
+	}
+
+	for (uint_fast8_t offset = 0; offset < count; offset++) {
+		if (queue_steal(&queues[(first + offset) % count], task)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+static void task_run(const task_t *task)
+{
+	task->func(task->param);
+
+	if (task->group != NULL && __atomic_sub_fetch(&task->group->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+		futex(&task->group->pending, FUTEX_WAKE_PRIVATE, INT32_MAX);
+	}
+}
+
+
+static void worker_thread(void *param)
+{
+	worker_index = (int_fast8_t)(intptr_t)param;
+
+	while (true) {
+		task_t task;
+
+		if (task_take(&task)) {
+			task_run(&task);
+		} else {
+			acc_driver_os_linux_futex_semaphore_wait(&work_available, TASK_POOL_IDLE_TIMEOUT_US);
+		}
+	}
+}
+
+
+static void pool_start(void)
+{
+	long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	uint_fast8_t count = (cpu_count < 1) ? 1 : (cpu_count > TASK_POOL_WORKER_COUNT_MAX) ? TASK_POOL_WORKER_COUNT_MAX : (uint_fast8_t)cpu_count;
+
+	acc_driver_os_linux_futex_semaphore_init(&work_available, 0);
+
+	acc_driver_os_linux_thread_attributes_t attributes;
+
+	acc_driver_os_linux_get_thread_attributes(&attributes);
+	attributes.stack_size	= TASK_POOL_STACK_SIZE;
+	attributes.name		= "acc_task_pool";
+
+	for (uint_fast8_t index = 0; index < count; index++) {
+		acc_driver_os_linux_futex_mutex_init(&queues[index].mutex);
+
+		// The workers run for the lifetime of the process and are never joined
+		if (acc_driver_os_linux_thread_create_ex(worker_thread, (void *)(intptr_t)index, &attributes) == NULL) {
+			ACC_LOG_ERROR("Unable to create task pool worker %u", (unsigned int)index);
+			break;
+		}
+
+		__atomic_store_n(&worker_count, index + 1, __ATOMIC_RELEASE);
+	}
+}
+
+
+void acc_driver_os_linux_task_pool_submit(acc_driver_os_linux_task_group_t *group, acc_driver_os_linux_task_t func, void *param)
+{
+	task_t task = {func, param, group};
+
+	pthread_once(&start_once, pool_start);
+
+	if (group != NULL) {
+		__atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+	}
+
+	uint_fast8_t count = __atomic_load_n(&worker_count, __ATOMIC_ACQUIRE);
+	uint_fast8_t queue;
+
+	if (worker_index >= 0) {
+		queue = worker_index;
+	} else {
+		queue = (count > 0) ? __atomic_fetch_add(&next_queue, 1, __ATOMIC_RELAXED) % count : 0;
+	}
+
+	if (count > 0 && queue_push(&queues[queue], &task)) {
+		acc_driver_os_linux_futex_semaphore_signal(&work_available);
+	} else {
+		task_run(&task);
+	}
+}
+
+
+void acc_driver_os_linux_task_pool_wait(acc_driver_os_linux_task_group_t *group)
+{
+	uint32_t pending;
+
+	while ((pending = __atomic_load_n(&group->pending, __ATOMIC_ACQUIRE)) != 0) {
+		task_t task;
+
+		// Help with any queued task instead of sleeping, the tasks of the group may be behind it
+		if (task_take(&task)) {
+			task_run(&task);
+		} else {
+			futex(&group->pending, FUTEX_WAIT_PRIVATE, pending);
+		}
+	}
+}
+
+
+uint_fast8_t acc_driver_os_linux_task_pool_get_worker_count(void)
+{
+	pthread_once(&start_once, pool_start);
+
+	return __atomic_load_n(&worker_count, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,270 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+// needed for clock_gettime
+// needed for clock_nanosleep
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "acc_log.h"
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief The module name
+ */
+#define MODULE "os_time"
+
+
+struct acc_driver_os_linux_timer_s {
+	int	fd;
+};
+
+
+/**
+ * @brief States of the cycle counter probe
+ */
+/**@{*/
+#define COUNTER_UNPROBED	(0)
+#define COUNTER_AVAILABLE	(1)
+#define COUNTER_UNAVAILABLE	(2)
+/**@}*/
+
+#if defined(__aarch64__) || (defined(__arm__) && defined(__ARM_ARCH) && (__ARM_ARCH >= 7) && defined(__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'A'))
+#define COUNTER_SUPPORTED
+#endif
+
+
+#if defined(COUNTER_SUPPORTED)
+static uint32_t	counter_state = COUNTER_UNPROBED;
+
+/**
+ * @brief Conversion from counter ticks to nanoseconds, ns = ticks * counter_mult >> counter_shift
+ */
+static uint32_t	counter_mult;
+static uint32_t	counter_shift;
+
+
+/**
+ * @brief Read the virtual count of the ARM generic timer
+ *
+ * This is the counter that the vDSO reads for CLOCK_MONOTONIC_RAW, without the conversion and the
+ * sequence lock.
+ */
+static uint64_t counter_read(void)
+{
+	uint64_t ticks;
+
+#if defined(__aarch64__)
+	__asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r" (ticks) :: "memory");
+#else
+	__asm__ __volatile__("isb\n\tmrrc p15, 1, %Q0, %R0, c14" : "=r" (ticks) :: "memory");
+#endif
+
+	return ticks;
+}
+
+
+static uint32_t counter_frequency(void)
+{
+	uint32_t frequency;
+
+#if defined(__aarch64__)
+	uint64_t value;
+
+	__asm__ __volatile__("mrs %0, cntfrq_el0" : "=r" (value));
+	frequency = (uint32_t)value;
+#else
+	__asm__ __volatile__("mrc p15, 0, %0, c14, c0, 0" : "=r" (frequency));
+#endif
+
+	return frequency;
+}
+
+
+/**
+ * @brief Check that the generic timer can be read from user space
+ *
+ * On 32 bit ARM, the timer is optional and user space access is only enabled by the kernel when the
+ * timer is the clock source, so reading it elsewhere would raise SIGILL.
+ */
+static bool counter_accessible(void)
+{
+#if defined(__aarch64__)
+	return true;
+#else
+	FILE	*file = fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+	char	name[32] = "";
+
+	if (file == NULL) {
+		return false;
+	}
+
+	if (fgets(name, sizeof(name), file) == NULL) {
+		name[0] = '\0';
+	}
+
+	fclose(file);
+
+	return strncmp(name, "arch_sys_counter", strlen("arch_sys_counter")) == 0;
+#endif
+}
+
+
+static uint32_t counter_probe(void)
+{
+	uint32_t frequency = counter_accessible() ? counter_frequency() : 0;
+
+	if (frequency == 0) {
+		return COUNTER_UNAVAILABLE;
+	}
+
+	// Use the largest shift that keeps the multiplier within 32 bits, for the best precision
+	uint32_t shift = 32;
+
+	while (shift > 0 && ((1000000000ull << shift) / frequency) > UINT32_MAX) {
+		shift--;
+	}
+
+	counter_mult	= (uint32_t)((1000000000ull << shift) / frequency);
+	counter_shift	= shift;
+
+	return COUNTER_AVAILABLE;
+}
+
+
+static uint64_t counter_to_ns(uint64_t ticks)
+{
+	// Split the count so that neither product overflows
+	uint64_t high = (ticks >> 32) * counter_mult;
+	uint64_t low = ((ticks & UINT32_MAX) * counter_mult) >> counter_shift;
+
+	return (high << (32 - counter_shift)) + low;
+}
+#endif
+
+
+uint64_t acc_driver_os_linux_time_ns(void)
+{
+#if defined(COUNTER_SUPPORTED)
+	uint32_t state = __atomic_load_n(&counter_state, __ATOMIC_ACQUIRE);
+
+	if (state == COUNTER_UNPROBED) {
+		// Probing is idempotent, threads racing here store the same result
+		state = counter_probe();
+		__atomic_store_n(&counter_state, state, __ATOMIC_RELEASE);
+	}
+
+	if (state == COUNTER_AVAILABLE) {
+		return counter_to_ns(counter_read());
+	}
+#endif
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+
+void acc_driver_os_linux_sleep_until(uint64_t deadline_ns)
+{
+	uint64_t now_ns = acc_driver_os_linux_time_ns();
+
+	if (deadline_ns <= now_ns) {
+		return;
+	}
+
+	// clock_nanosleep() can not sleep on CLOCK_MONOTONIC_RAW or the generic timer, so the deadline is
+	// moved to CLOCK_MONOTONIC. The clocks only differ by the NTP slew over the remaining time.
+	uint64_t	remaining_ns = deadline_ns - now_ns;
+	struct timespec	deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec		+= remaining_ns / 1000000000;
+	deadline.tv_nsec	+= remaining_ns % 1000000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+	}
+}
+
+
+acc_driver_os_linux_timer_t acc_driver_os_linux_timer_create(uint32_t period_us)
+{
+	if (period_us == 0) {
+		ACC_LOG_ERROR("Timer period must not be 0");
+		return NULL;
+	}
+
+	acc_driver_os_linux_timer_t timer = malloc(sizeof(*timer));
+
+	if (timer == NULL) {
+		return NULL;
+	}
+
+	timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (timer->fd == -1) {
+		ACC_LOG_ERROR("timerfd_create failed: %s", strerror(errno));
+		free(timer);
+		return NULL;
+	}
+
+	struct itimerspec spec;
+
+	spec.it_interval.tv_sec		= period_us / 1000000;
+	spec.it_interval.tv_nsec	= (long)(period_us % 1000000) * 1000;
+	spec.it_value			= spec.it_interval;
+
+	if (timerfd_settime(timer->fd, 0, &spec, NULL) == -1) {
+		ACC_LOG_ERROR("timerfd_settime failed: %s", strerror(errno));
+		close(timer->fd);
+		free(timer);
+		return NULL;
+	}
+
+	return timer;
+}
+
+
+uint32_t acc_driver_os_linux_timer_wait(acc_driver_os_linux_timer_t timer)
+{
+	uint64_t	expirations;
+	ssize_t		result;
+
+	do {
+		result = read(timer->fd, &expirations, sizeof(expirations));
+	} while (result == -1 && errno == EINTR);
+
+	if (result != sizeof(expirations)) {
+		ACC_LOG_ERROR("Timer read failed: %s", strerror(errno));
+		return 0;
+	}
+
+	return (expirations > UINT32_MAX) ? UINT32_MAX : (uint32_t)expirations;
+}
+
+
+void acc_driver_os_linux_timer_destroy(acc_driver_os_linux_timer_t *timer)
+{
+	if (timer == NULL || *timer == NULL) {
+		return;
+	}
+
+	close((*timer)->fd);
+	free(*timer);
+	*timer = NULL;
+}
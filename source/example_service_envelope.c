@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "acc_rss.h"
 #include "acc_service.h"
@@ -13,6 +14,7 @@
 #include "acc_sweep_configuration.h"
 
 #include "acc_os.h"
+#include "acc_os_linux.h"
 #include "acc_version.h"
 
 
@@ -29,7 +31,7 @@
  *   - Deactivate and destroy the envelope service
  *   - Reconfigure the envelope service configuration with callback mode
  *   - Create and activate envelope service
- *   - Get the result and print it 2 times
+ *   - Pass the result from the callback to the main thread through a ring and print it 2 times
  *   - Deactivate and destroy the envelope service
  *   - Destroy the envelope service configuration
  *   - Deactivate Radar System Services
@@ -42,10 +44,21 @@ static void envelope_callback(const acc_service_handle_t service_handle, const u
 static void reconfigure_sweeps(acc_service_configuration_t envelope_configuration);
 
 
+/**
+ * @brief Number of sweeps the callback can be ahead of the main thread
+ */
+#define SWEEP_RING_CAPACITY	4
+
+/**
+ * @brief Maximum time the main thread waits for a sweep [us]
+ */
+#define SWEEP_TIMEOUT_US	1000000
+
+
 typedef struct
 {
 	uint16_t                   data_length;
-	uint_fast8_t               sweep_count;
+	acc_driver_os_linux_ring_t sweeps;
 } envelope_callback_user_data_t;
 
 
@@ -179,24 +192,54 @@ acc_service_status_t execute_envelope_with_callback(acc_service_configuration_t
 	printf("Actual end: %u mm\n", (unsigned int)((envelope_metadata.actual_start_m + envelope_metadata.actual_length_m) * 1000.0 + 0.5));
 	printf("Data length: %u\n", (unsigned int)(envelope_metadata.data_length));
 
-	// Configure callback user data
-	callback_user_data.sweep_count = 2;
+	// Each element of the ring is the sequence number followed by the envelope
+	size_t sweep_size = sizeof(uint32_t) + (envelope_metadata.data_length * sizeof(uint16_t));
+
 	callback_user_data.data_length = envelope_metadata.data_length;
+	callback_user_data.sweeps = acc_driver_os_linux_ring_create(ACC_DRIVER_OS_LINUX_RING_SPSC, sweep_size, SWEEP_RING_CAPACITY);
+
+	if (callback_user_data.sweeps == NULL) {
+		printf("acc_driver_os_linux_ring_create failed\n");
+		acc_service_destroy(&handle);
+		return ACC_SERVICE_STATUS_FAILURE_UNSPECIFIED;
+	}
 
 	acc_service_status_t service_status = acc_service_activate(handle);
 
 	if (service_status == ACC_SERVICE_STATUS_OK) {
-		while (callback_user_data.sweep_count > 0) {
-			acc_os_sleep_us(200);
+		uint32_t sweep[(sweep_size + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+		uint16_t *envelope_data = (uint16_t *)&sweep[1];
+
+		for (uint_fast8_t sweep_count = 0; sweep_count < 2; sweep_count++) {
+			if (!acc_driver_os_linux_ring_pop(callback_user_data.sweeps, sweep, SWEEP_TIMEOUT_US)) {
+				printf("No envelope received from callback\n");
+				service_status = ACC_SERVICE_STATUS_FAILURE_UNSPECIFIED;
+				break;
+			}
+
+			printf("Envelope callback result_info->sequence_number: %u\n", (unsigned int)sweep[0]);
+			printf("Envelope callback data:\n");
+			for (uint_fast16_t index = 0; index < envelope_metadata.data_length; index++) {
+				if (index && !(index % 8)) {
+					printf("\n");
+				}
+				printf("%6u", (unsigned int)(envelope_data[index]));
+			}
+			printf("\n");
 		}
 
-		service_status = acc_service_deactivate(handle);
+		acc_service_status_t deactivate_status = acc_service_deactivate(handle);
+
+		if (service_status == ACC_SERVICE_STATUS_OK) {
+			service_status = deactivate_status;
+		}
 	}
 	else {
 		printf("acc_service_activate() %u => %s\n", (unsigned int)service_status, acc_service_status_name_get(service_status));
 	}
 
 	acc_service_destroy(&handle);
+	acc_driver_os_linux_ring_destroy(&callback_user_data.sweeps);
 
 	return service_status;
 }
@@ -207,20 +250,12 @@ void envelope_callback(const acc_service_handle_t service_handle, const uint16_t
 	ACC_UNUSED(service_handle);
 
 	envelope_callback_user_data_t *callback_user_data = user_reference;
+	uint32_t sweep[1 + ((callback_user_data->data_length * sizeof(uint16_t) + sizeof(uint32_t) - 1) / sizeof(uint32_t))];
 
-	if (callback_user_data->sweep_count > 0) {
-		printf("Envelope callback result_info->sequence_number: %u\n", (unsigned int)result_info->sequence_number);
-		printf("Envelope callback data:\n");
-		for (uint_fast16_t index = 0; index < callback_user_data->data_length; index++) {
-			if (index && !(index % 8)) {
-				printf("\n");
-			}
-			printf("%6u", (unsigned int)(envelope_data[index]));
-		}
-		printf("\n");
-
-		callback_user_data->sweep_count--;
-	}
+	// Copy the sweep and return at once, the main thread prints it. Sweeps are dropped while the ring is full.
+	sweep[0] = result_info->sequence_number;
+	memcpy(&sweep[1], envelope_data, callback_user_data->data_length * sizeof(uint16_t));
+	acc_driver_os_linux_ring_push(callback_user_data->sweeps, sweep);
 }
 
 
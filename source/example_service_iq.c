@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "acc_log.h"
 #include "acc_rss.h"
@@ -15,6 +16,7 @@
 #include "acc_sweep_configuration.h"
 
 #include "acc_os.h"
+#include "acc_os_linux.h"
 #include "acc_version.h"
 
 
@@ -31,7 +33,7 @@
  *   - Deactivate and destroy the IQ service
  *   - Reconfigure the IQ service configuration with callback mode
  *   - Create and activate IQ service
- *   - Get the result and print it 2 times
+ *   - Pass the result from the callback to the main thread through a ring and print it 2 times
  *   - Deactivate and destroy the IQ service
  *   - Destroy the IQ service configuration
  *   - Deactivate Radar System Services
@@ -43,10 +45,22 @@ static acc_service_status_t execute_iq_with_callback(acc_service_configuration_t
 static void iq_callback(const acc_service_handle_t service_handle, const float complex *iq_data, const acc_service_iq_result_info_t *result_info, void *user_reference);
 static void reconfigure_sweeps(acc_service_configuration_t iq_configuration);
 
+
+/**
+ * @brief Number of sweeps the callback can be ahead of the main thread
+ */
+#define SWEEP_RING_CAPACITY	4
+
+/**
+ * @brief Maximum time the main thread waits for a sweep [us]
+ */
+#define SWEEP_TIMEOUT_US	1000000
+
+
 typedef struct
 {
 	uint16_t                   data_length;
-	uint_fast8_t               sweep_count;
+	acc_driver_os_linux_ring_t sweeps;
 } iq_callback_user_data_t;
 
 
@@ -181,24 +195,54 @@ acc_service_status_t execute_iq_with_callback(acc_service_configuration_t iq_con
 	printf("Actual end: %u mm\n", (unsigned int)((iq_metadata.actual_start_m + iq_metadata.actual_length_m) * 1000.0 + 0.5));
 	printf("Data length: %u\n", (unsigned int)(iq_metadata.data_length));
 
-	// Configure callback user data
-	iq_callback_user_data.sweep_count = 2;
+	// Each element of the ring is the sequence number followed by the IQ data
+	size_t sweep_size = sizeof(uint32_t) + (iq_metadata.data_length * sizeof(float complex));
+
 	iq_callback_user_data.data_length = iq_metadata.data_length;
+	iq_callback_user_data.sweeps = acc_driver_os_linux_ring_create(ACC_DRIVER_OS_LINUX_RING_SPSC, sweep_size, SWEEP_RING_CAPACITY);
+
+	if (iq_callback_user_data.sweeps == NULL) {
+		printf("acc_driver_os_linux_ring_create failed\n");
+		acc_service_destroy(&handle);
+		return ACC_SERVICE_STATUS_FAILURE_UNSPECIFIED;
+	}
 
 	acc_service_status_t service_status = acc_service_activate(handle);
 
 	if (service_status == ACC_SERVICE_STATUS_OK) {
-		while (iq_callback_user_data.sweep_count > 0) {
-			acc_os_sleep_us(200);
+		uint32_t sweep[(sweep_size + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+		float complex *iq_data = (float complex *)&sweep[1];
+
+		for (uint_fast8_t sweep_count = 0; sweep_count < 2; sweep_count++) {
+			if (!acc_driver_os_linux_ring_pop(iq_callback_user_data.sweeps, sweep, SWEEP_TIMEOUT_US)) {
+				printf("No IQ data received from callback\n");
+				service_status = ACC_SERVICE_STATUS_FAILURE_UNSPECIFIED;
+				break;
+			}
+
+			printf("IQ callback result_info->sequence_number: %u\n", (unsigned int)sweep[0]);
+			printf("IQ callback data in cartesian coordinates (a, b):\n");
+			for (uint_fast16_t index = 0; index < iq_metadata.data_length; index++) {
+				if (index && !(index % 8)) {
+					printf("\n");
+				}
+				printf("(%"PRIfloat", %"PRIfloat")\t", ACC_LOG_FLOAT_TO_INTEGER(crealf(iq_data[index])), ACC_LOG_FLOAT_TO_INTEGER(cimagf(iq_data[index])));
+			}
+			printf("\n");
 		}
 
-		service_status = acc_service_deactivate(handle);
+		acc_service_status_t deactivate_status = acc_service_deactivate(handle);
+
+		if (service_status == ACC_SERVICE_STATUS_OK) {
+			service_status = deactivate_status;
+		}
 	}
 	else {
 		printf("acc_service_activate() %u => %s\n", (unsigned int)service_status, acc_service_status_name_get(service_status));
 	}
 
 	acc_service_destroy(&handle);
+	acc_driver_os_linux_ring_destroy(&iq_callback_user_data.sweeps);
 
 	return service_status;
 }
@@ -209,20 +253,12 @@ void iq_callback(const acc_service_handle_t service_handle, const float complex
 	ACC_UNUSED(service_handle);
 
 	iq_callback_user_data_t *iq_callback_user_data = user_reference;
+	uint32_t sweep[1 + ((iq_callback_user_data->data_length * sizeof(float complex) + sizeof(uint32_t) - 1) / sizeof(uint32_t))];
 
-	if (iq_callback_user_data->sweep_count > 0) {
-		printf("IQ callback result_info->sequence_number: %u\n", (unsigned int)result_info->sequence_number);
-		printf("IQ callback data in cartesian coordinates (a, b):\n");
-		for (uint_fast16_t index = 0; index < iq_callback_user_data->data_length; index++) {
-			if (index && !(index % 8)) {
-				printf("\n");
-			}
-			printf("(%"PRIfloat", %"PRIfloat")\t", ACC_LOG_FLOAT_TO_INTEGER(crealf(iq_data[index])), ACC_LOG_FLOAT_TO_INTEGER(cimagf(iq_data[index])));
-		}
-		printf("\n");
-
-		iq_callback_user_data->sweep_count--;
-	}
+	// Copy the sweep and return at once, the main thread prints it. Sweeps are dropped while the ring is full.
+	sweep[0] = result_info->sequence_number;
+	memcpy(&sweep[1], iq_data, iq_callback_user_data->data_length * sizeof(float complex));
+	acc_driver_os_linux_ring_push(iq_callback_user_data->sweeps, sweep);
 }
 
 
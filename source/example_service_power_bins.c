@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "acc_rss.h"
 #include "acc_service.h"
@@ -13,6 +15,7 @@
 #include "acc_sweep_configuration.h"
 
 #include "acc_os.h"
+#include "acc_os_linux.h"
 #include "acc_version.h"
 
 
@@ -29,7 +32,8 @@
  *   - Deactivate and destroy the Power Bins service
  *   - Reconfigure the Power Bins service configuration with callback mode
  *   - Create and activate Power Bins service
- *   - Get the result and print it 2 times
+ *   - Pass the result from the callback to the main thread through a ring and print it until no
+ *     result arrives in time
  *   - Deactivate and destroy the Power Bins service
  *   - Destroy the Power Bins service configuration
  *   - Deactivate Radar System Services
@@ -42,13 +46,34 @@ static void power_bins_callback(const acc_service_handle_t service_handle, const
 static void reconfigure_sweeps(acc_service_configuration_t envelope_configuration);
 
 
+/**
+ * @brief Number of sweeps the callback can be ahead of the main thread
+ */
+#define SWEEP_RING_CAPACITY	4
+
+/**
+ * @brief Maximum time the main thread waits for a sweep [us]
+ */
+#define SWEEP_TIMEOUT_US	1000000
+
+
 typedef struct
 {
 	uint16_t                   bin_count;
-	uint_fast8_t               sweep_count;
+	acc_driver_os_linux_ring_t sweeps;
 } power_bins_callback_user_data_t;
 
 
+/**
+ * @brief Start of each element of the ring, followed by the power bins
+ */
+typedef struct
+{
+	time_t                     time;
+	uint32_t                   sequence_number;
+} power_bins_sweep_header_t;
+
+
 int main(int argc, char *argv[])
 {
 	ACC_UNUSED(argc);
@@ -175,27 +200,47 @@ acc_service_status_t execute_power_bins_with_callback(acc_service_configuration_
 	printf("Actual end: %u mm\n", (unsigned int)((power_bins_metadata.actual_start_m + power_bins_metadata.actual_length_m) * 1000.0 + 0.5));
 	printf("Bin count: %u\n", (unsigned int)(power_bins_metadata.actual_bin_count));
 
-	// Configure callback user data
-	callback_user_data.sweep_count = 50;
-	//callback_user_data.bin_count = power_bins_metadata.actual_bin_count;
-	callback_user_data.bin_count = 15;
+	// Each element of the ring is the time of the sweep and its sequence number followed by the power bins
+	size_t sweep_size = sizeof(power_bins_sweep_header_t) + (power_bins_metadata.actual_bin_count * sizeof(float));
+
+	callback_user_data.bin_count = power_bins_metadata.actual_bin_count;
+	callback_user_data.sweeps = acc_driver_os_linux_ring_create(ACC_DRIVER_OS_LINUX_RING_SPSC, sweep_size, SWEEP_RING_CAPACITY);
+
+	if (callback_user_data.sweeps == NULL) {
+		printf("acc_driver_os_linux_ring_create failed\n");
+		acc_service_destroy(&handle);
+		return ACC_SERVICE_STATUS_FAILURE_UNSPECIFIED;
+	}
 
 	acc_service_status_t service_status = acc_service_activate(handle);
 
 	if (service_status == ACC_SERVICE_STATUS_OK) {
-		while (callback_user_data.sweep_count > 0) {
-			acc_os_sleep_us(200);
+		uint64_t sweep[(sweep_size + sizeof(uint64_t) - 1) / sizeof(uint64_t)];
+		power_bins_sweep_header_t *header = (power_bins_sweep_header_t *)sweep;
+		float *power_bins_data = (float *)&header[1];
+
+		// Print until the sweeps stop, the main thread does the printing so that the callback never waits for it
+		while (acc_driver_os_linux_ring_pop(callback_user_data.sweeps, sweep, SWEEP_TIMEOUT_US)) {
+			struct tm *p = localtime(&header->time);
+
+			printf("Power_bins callback result_info->sequence_number: %u\n", (unsigned int)header->sequence_number);
+			printf("Power_bins callback data:\n");
+			printf("%d-%d-%d %d:%d:%d : ", (1900 + p->tm_year), ( 1 + p->tm_mon), p->tm_mday,(p->tm_hour ), p->tm_min, p->tm_sec);
+			for (uint_fast16_t index = 0; index < power_bins_metadata.actual_bin_count; index++) {
+				printf("%u\t%u", (unsigned int)index, (unsigned int)(power_bins_data[index] + 0.5));
+			}
+			printf("\n");
 		}
 
+		printf("No power bins received from callback\n");
 		service_status = acc_service_deactivate(handle);
 	}
 	else {
 		printf("acc_service_activate() %u => %s\n", (unsigned int)service_status, acc_service_status_name_get(service_status));
 	}
 
-	if (handle != NULL) {
-		acc_service_destroy(&handle);
-	}
+	acc_service_destroy(&handle);
+	acc_driver_os_linux_ring_destroy(&callback_user_data.sweeps);
 
 	return service_status;
 }
@@ -203,27 +248,17 @@ acc_service_status_t execute_power_bins_with_callback(acc_service_configuration_
 
 void power_bins_callback(const acc_service_handle_t service_handle, const float *power_bins_data, const acc_service_power_bins_result_info_t *result_info, void *user_reference)
 {
-	time_t timep;	 
-	struct tm *p; 
-
-	time(&timep);   
-	p = localtime(&timep);
-
 	ACC_UNUSED(service_handle);
 
 	power_bins_callback_user_data_t *callback_user_data = user_reference;
-
-	if (callback_user_data->sweep_count > 0) {
-		printf("Power_bins callback result_info->sequence_number: %u\n", (unsigned int)result_info->sequence_number);
-		printf("Power_bins callback data:\n");
-		printf("%d-%d-%d %d:%d:%d : ", (1900 + p->tm_year), ( 1 + p->tm_mon), p->tm_mday,(p->tm_hour ), p->tm_min, p->tm_sec); 
-		for (uint_fast16_t index = 0; index < callback_user_data->bin_count; index++) {
-			printf("%u\t%u", (unsigned int)index, (unsigned int)(power_bins_data[index] + 0.5));
-		}
-		printf("\n");
-
-		//callback_user_data->sweep_count--;
-	}
+	uint64_t sweep[(sizeof(power_bins_sweep_header_t) + (callback_user_data->bin_count * sizeof(float)) + sizeof(uint64_t) - 1) / sizeof(uint64_t)];
+	power_bins_sweep_header_t *header = (power_bins_sweep_header_t *)sweep;
+
+	// Copy the sweep and return at once, the main thread prints it. Sweeps are dropped while the ring is full.
+	header->time		= time(NULL);
+	header->sequence_number	= result_info->sequence_number;
+	memcpy(&header[1], power_bins_data, callback_user_data->bin_count * sizeof(float));
+	acc_driver_os_linux_ring_push(callback_user_data->sweeps, sweep);
 }
 
 
@@ -0,0 +1,206 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "acc_board.h"
+#include "acc_definitions.h"
+#include "acc_driver_hal.h"
+#include "acc_log.h"
+#include "acc_os.h"
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief Benchmark of the per-transfer overhead of the HAL driver
+ *
+ * The benchmark executes as follows:
+ *   - Initialize the HAL driver and the board
+ *   - Power on the sensor with prepared transfers, run a number of transfers and power it off
+ *   - Power on the sensor with prepared transfers disabled, run the same transfers through the
+ *     generic board and device functions and power it off
+ *   - Print the time per transfer and the mean time of each transfer phase for both paths
+ *
+ * The transfers carry a zero filled buffer. Run the benchmark on a sensor that no other program uses.
+ */
+
+
+#define DEFAULT_SENSOR_ID		1
+#define DEFAULT_TRANSFER_COUNT		10000
+#define DEFAULT_TRANSFER_SIZE		16
+
+
+typedef struct {
+	acc_sensor_id_t sensor_id;
+	uint32_t transfer_count;
+	size_t transfer_size;
+} input_t;
+
+
+static const char *phase_names[ACC_BOARD_TRANSFER_PHASE_COUNT] = {"lock", "chip select", "spi", "deselect"};
+
+
+static bool parse_options(int argc, char *argv[], input_t *input);
+static bool run_transfer_benchmark(const acc_hal_t *hal, const input_t *input, bool prepared, uint8_t *buffer);
+
+
+int main(int argc, char *argv[])
+{
+	input_t input = {DEFAULT_SENSOR_ID, DEFAULT_TRANSFER_COUNT, DEFAULT_TRANSFER_SIZE};
+
+	acc_log_set_level(ACC_LOG_LEVEL_ERROR, NULL);
+
+	if (!parse_options(argc, argv, &input)) {
+		return EXIT_FAILURE;
+	}
+
+	if (!acc_driver_hal_init()) {
+		return EXIT_FAILURE;
+	}
+
+	acc_hal_t hal = acc_driver_hal_get_implementation();
+
+	if ((input.sensor_id == 0) || (input.sensor_id > hal.properties.sensor_count)) {
+		printf("Invalid sensor id, the board has %u sensors.\n", (unsigned int)hal.properties.sensor_count);
+		return EXIT_FAILURE;
+	}
+
+	if (input.transfer_size > hal.properties.max_spi_transfer_size) {
+		printf("Invalid transfer size, at most %u bytes.\n", (unsigned int)hal.properties.max_spi_transfer_size);
+		return EXIT_FAILURE;
+	}
+
+	uint8_t *buffer = acc_os_mem_alloc(input.transfer_size);
+
+	if (buffer == NULL) {
+		printf("acc_os_mem_alloc() failed\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Sensor %u, %u transfers of %u bytes\n", (unsigned int)input.sensor_id, (unsigned int)input.transfer_count,
+	       (unsigned int)input.transfer_size);
+
+	bool success = run_transfer_benchmark(&hal, &input, true, buffer) && run_transfer_benchmark(&hal, &input, false, buffer);
+
+	acc_driver_hal_set_prepared_transfers(true);
+	acc_os_mem_free(buffer);
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+static void print_usage(void)
+{
+	printf("Usage: util_hal_transfer_benchmark [OPTION]...\n\n");
+	printf("-h, --help                  this help\n");
+	printf("-s, --sensor                the sensor to transfer to, default %u\n", (unsigned int)DEFAULT_SENSOR_ID);
+	printf("-n, --transfers             transfers per path, default %u\n", (unsigned int)DEFAULT_TRANSFER_COUNT);
+	printf("-b, --size                  bytes per transfer, default %u\n", (unsigned int)DEFAULT_TRANSFER_SIZE);
+}
+
+
+bool parse_options(int argc, char *argv[], input_t *input)
+{
+	static struct option long_options[] =
+	{
+		{"sensor",          required_argument,  0,      's'},
+		{"transfers",       required_argument,  0,      'n'},
+		{"size",            required_argument,  0,      'b'},
+		{"help",            no_argument,        0,      'h'},
+		{NULL,              0,                  NULL,   0}
+	};
+
+	int16_t character_code;
+	int32_t option_index = 0;
+
+	while ((character_code = getopt_long(argc, argv, "s:n:b:h?", long_options, &option_index)) != -1) {
+		switch (character_code) {
+			case 's':
+			{
+				input->sensor_id = atoi(optarg);
+				break;
+			}
+			case 'n':
+			{
+				input->transfer_count = strtoul(optarg, NULL, 10);
+				if (input->transfer_count == 0) {
+					printf("Invalid number of transfers.\n");
+					print_usage();
+					return false;
+				}
+				break;
+			}
+			case 'b':
+			{
+				input->transfer_size = strtoul(optarg, NULL, 10);
+				if (input->transfer_size == 0) {
+					printf("Invalid transfer size.\n");
+					print_usage();
+					return false;
+				}
+				break;
+			}
+			case 'h':
+			case '?':
+			{
+				print_usage();
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+bool run_transfer_benchmark(const acc_hal_t *hal, const input_t *input, bool prepared, uint8_t *buffer)
+{
+	const char *path_name = prepared ? "prepared" : "generic";
+
+	acc_driver_hal_set_prepared_transfers(prepared);
+
+	if (!hal->sensor_device.power_on(input->sensor_id)) {
+		printf("Unable to power on sensor %u\n", (unsigned int)input->sensor_id);
+		return false;
+	}
+
+	acc_driver_hal_reset_transfer_timing();
+	acc_driver_hal_set_transfer_timing(true);
+
+	bool		success = true;
+	uint64_t	start_ns = acc_driver_os_linux_time_ns();
+
+	for (uint32_t index = 0; success && index < input->transfer_count; index++) {
+		memset(buffer, 0, input->transfer_size);
+		success = hal->sensor_device.transfer(input->sensor_id, buffer, input->transfer_size);
+	}
+
+	uint64_t elapsed_ns = acc_driver_os_linux_time_ns() - start_ns;
+
+	acc_driver_hal_set_transfer_timing(false);
+	hal->sensor_device.power_off(input->sensor_id);
+
+	if (!success) {
+		printf("Transfer to sensor %u failed on the %s path\n", (unsigned int)input->sensor_id, path_name);
+		return false;
+	}
+
+	printf("%-9s %.0f ns per transfer\n", path_name, (double)elapsed_ns / input->transfer_count);
+
+	for (uint_fast8_t phase = 0; phase < ACC_BOARD_TRANSFER_PHASE_COUNT; phase++) {
+		acc_driver_hal_transfer_timing_t timing;
+
+		if (acc_driver_hal_get_transfer_timing(input->sensor_id, phase, &timing) && (timing.count > 0)) {
+			printf("          %-12s mean %.0f ns, max %u ns\n", phase_names[phase], (double)timing.sum_ns / timing.count,
+			       (unsigned int)timing.max_ns);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,362 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "acc_board.h"
+#include "acc_driver_hal.h"
+#include "acc_log.h"
+#include "acc_os.h"
+#include "acc_os_linux.h"
+#include "acc_rss.h"
+#include "acc_service.h"
+#include "acc_service_envelope.h"
+#include "acc_sweep_configuration.h"
+
+
+/**
+ * @brief Benchmark of the allocator behind acc_os_mem_alloc()
+ *
+ * The benchmark executes as follows:
+ *   - Select the allocator and register the OS driver
+ *   - Allocate and free a mix of small sizes from several threads, keeping a window of live allocations
+ *   - Create, activate, deactivate and destroy an envelope service repeatedly, optionally with
+ *     each cycle after the first in an arena scope
+ *   - Print the rates, the pool statistics if the pool allocator is used and the heap usage if accounting is enabled
+ */
+
+
+#define DEFAULT_THREAD_COUNT		4
+#define DEFAULT_ALLOCATION_COUNT	1000000
+#define DEFAULT_CYCLE_COUNT		20
+#define THREAD_COUNT_MAX		16
+#define LIVE_ALLOCATION_COUNT		64
+
+
+typedef struct {
+	acc_driver_os_linux_allocator_t allocator;
+	uint_fast8_t thread_count;
+	uint32_t allocation_count;
+	uint16_t cycle_count;
+	size_t arena_size;
+	bool mem_accounting;
+} input_t;
+
+
+typedef struct {
+	uint32_t allocation_count;
+	uint32_t failures;
+} worker_t;
+
+
+static bool parse_options(int argc, char *argv[], input_t *input);
+static void allocation_worker(void *param);
+static bool run_allocation_benchmark(const input_t *input);
+static bool run_service_benchmark(const input_t *input);
+static void print_pool_stats(void);
+
+
+int main(int argc, char *argv[])
+{
+	input_t input = {ACC_DRIVER_OS_LINUX_ALLOCATOR_MALLOC, DEFAULT_THREAD_COUNT, DEFAULT_ALLOCATION_COUNT, DEFAULT_CYCLE_COUNT, 0, false};
+
+	acc_log_set_level(ACC_LOG_LEVEL_FATAL, NULL);
+
+	if (!parse_options(argc, argv, &input)) {
+		return EXIT_FAILURE;
+	}
+
+	// The allocator must be selected before the OS driver is registered by the board
+	acc_driver_os_linux_set_allocator(input.allocator);
+	acc_driver_os_linux_set_mem_accounting(input.mem_accounting);
+
+	if (acc_board_init() != ACC_STATUS_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	printf("Allocator: %s\n", input.allocator == ACC_DRIVER_OS_LINUX_ALLOCATOR_POOL ? "pool" : "malloc");
+
+	if (!run_allocation_benchmark(&input)) {
+		return EXIT_FAILURE;
+	}
+
+	if ((input.cycle_count > 0) && !run_service_benchmark(&input)) {
+		return EXIT_FAILURE;
+	}
+
+	if (input.allocator == ACC_DRIVER_OS_LINUX_ALLOCATOR_POOL) {
+		print_pool_stats();
+	}
+
+	if (input.mem_accounting) {
+		acc_driver_os_linux_mem_print_report(stdout);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+static void print_usage(void)
+{
+	printf("Usage: util_os_allocator_benchmark [OPTION]...\n\n");
+	printf("-h, --help                  this help\n");
+	printf("-a, --allocator             allocator to benchmark, malloc or pool, default malloc\n");
+	printf("-j, --threads               number of allocating threads, default %u, max %u\n", (unsigned int)DEFAULT_THREAD_COUNT,
+	       (unsigned int)THREAD_COUNT_MAX);
+	printf("-n, --allocations           allocations per thread, default %u\n", (unsigned int)DEFAULT_ALLOCATION_COUNT);
+	printf("-c, --cycles                service create/activate/deactivate/destroy cycles, 0 to skip, default %u\n",
+	       (unsigned int)DEFAULT_CYCLE_COUNT);
+	printf("-s, --arena-size            run the service cycles in an arena of this many bytes, default none\n");
+	printf("-m, --accounting            enable heap accounting and print the heap usage per call site\n");
+}
+
+
+bool parse_options(int argc, char *argv[], input_t *input)
+{
+	static struct option long_options[] =
+	{
+		{"allocator",       required_argument,  0,      'a'},
+		{"threads",         required_argument,  0,      'j'},
+		{"allocations",     required_argument,  0,      'n'},
+		{"cycles",          required_argument,  0,      'c'},
+		{"arena-size",      required_argument,  0,      's'},
+		{"accounting",      no_argument,        0,      'm'},
+		{"help",            no_argument,        0,      'h'},
+		{NULL,              0,                  NULL,   0}
+	};
+
+	int16_t character_code;
+	int32_t option_index = 0;
+
+	while ((character_code = getopt_long(argc, argv, "a:j:n:c:s:mh?", long_options, &option_index)) != -1) {
+		switch (character_code) {
+			case 'a':
+			{
+				if (strcmp(optarg, "pool") == 0) {
+					input->allocator = ACC_DRIVER_OS_LINUX_ALLOCATOR_POOL;
+				} else if (strcmp(optarg, "malloc") == 0) {
+					input->allocator = ACC_DRIVER_OS_LINUX_ALLOCATOR_MALLOC;
+				} else {
+					printf("Invalid allocator.\n");
+					print_usage();
+					return false;
+				}
+				break;
+			}
+			case 'j':
+			{
+				input->thread_count = atoi(optarg);
+				if ((input->thread_count == 0) || (input->thread_count > THREAD_COUNT_MAX)) {
+					printf("Invalid number of threads.\n");
+					print_usage();
+					return false;
+				}
+				break;
+			}
+			case 'n':
+			{
+				input->allocation_count = strtoul(optarg, NULL, 10);
+				break;
+			}
+			case 'c':
+			{
+				input->cycle_count = atoi(optarg);
+				break;
+			}
+			case 's':
+			{
+				input->arena_size = strtoul(optarg, NULL, 10);
+				break;
+			}
+			case 'm':
+			{
+				input->mem_accounting = true;
+				break;
+			}
+			case 'h':
+			case '?':
+			{
+				print_usage();
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+void allocation_worker(void *param)
+{
+	worker_t	*worker = param;
+	void		*live[LIVE_ALLOCATION_COUNT] = {NULL};
+	uint32_t	random = 0x12345678;
+
+	for (uint32_t index = 0; index < worker->allocation_count; index++) {
+		uint_fast8_t slot = index % LIVE_ALLOCATION_COUNT;
+
+		// Sizes of typical small objects, 8 to 512 bytes, from a cheap pseudo random sequence
+		random = random * 1103515245 + 12345;
+		size_t size = (size_t)8 << ((random >> 16) % 7);
+
+		acc_os_mem_free(live[slot]);
+		live[slot] = acc_os_mem_alloc(size);
+		if (live[slot] == NULL) {
+			worker->failures++;
+		} else {
+			memset(live[slot], 0, size);
+		}
+	}
+
+	for (uint_fast8_t slot = 0; slot < LIVE_ALLOCATION_COUNT; slot++) {
+		acc_os_mem_free(live[slot]);
+	}
+}
+
+
+bool run_allocation_benchmark(const input_t *input)
+{
+	acc_os_thread_handle_t	threads[THREAD_COUNT_MAX];
+	worker_t		workers[THREAD_COUNT_MAX];
+	uint32_t		failures = 0;
+
+	uint64_t start_ns = acc_driver_os_linux_time_ns();
+
+	for (uint_fast8_t index = 0; index < input->thread_count; index++) {
+		workers[index].allocation_count	= input->allocation_count;
+		workers[index].failures		= 0;
+
+		threads[index] = acc_os_thread_create(allocation_worker, &workers[index]);
+		if (threads[index] == NULL) {
+			printf("acc_os_thread_create() failed\n");
+			return false;
+		}
+	}
+
+	for (uint_fast8_t index = 0; index < input->thread_count; index++) {
+		acc_os_thread_cleanup(threads[index]);
+		failures += workers[index].failures;
+	}
+
+	uint64_t	elapsed_ns = acc_driver_os_linux_time_ns() - start_ns;
+	double		operations = 2.0 * input->allocation_count * input->thread_count;
+
+	printf("Allocation: %u threads, %.0f alloc+free/s, %.1f ns per operation, %u failures\n", (unsigned int)input->thread_count,
+	       operations / 2 / (elapsed_ns / 1e9), elapsed_ns * (double)input->thread_count / operations, (unsigned int)failures);
+
+	return failures == 0;
+}
+
+
+bool run_service_benchmark(const input_t *input)
+{
+	if (!acc_driver_hal_init()) {
+		return false;
+	}
+
+	acc_hal_t hal = acc_driver_hal_get_implementation();
+
+	if (!acc_rss_activate_with_hal(&hal)) {
+		return false;
+	}
+
+	acc_service_configuration_t configuration = acc_service_envelope_configuration_create();
+
+	if (configuration == NULL) {
+		printf("acc_service_envelope_configuration_create() failed\n");
+		acc_rss_deactivate();
+		return false;
+	}
+
+	acc_driver_os_linux_arena_t arena = NULL;
+
+	if (input->arena_size > 0) {
+		arena = acc_driver_os_linux_arena_create(input->arena_size);
+		if (arena == NULL) {
+			printf("acc_driver_os_linux_arena_create() failed\n");
+			acc_service_envelope_configuration_destroy(&configuration);
+			acc_rss_deactivate();
+			return false;
+		}
+	}
+
+	uint64_t		start_ns = acc_driver_os_linux_time_ns();
+	acc_service_status_t	service_status = ACC_SERVICE_STATUS_OK;
+	uint_fast16_t		cycle;
+
+	for (cycle = 0; cycle < input->cycle_count; cycle++) {
+		// State that RSS keeps between services, like the calibration, is created by the first cycle outside the arena
+		bool scoped = (arena != NULL) && (cycle > 0) && acc_driver_os_linux_arena_scope_begin(arena);
+
+		acc_service_handle_t handle = acc_service_create(configuration);
+
+		if (handle == NULL) {
+			printf("acc_service_create() failed\n");
+			if (scoped) {
+				acc_driver_os_linux_arena_scope_end();
+			}
+			service_status = ACC_SERVICE_STATUS_FAILURE_UNSPECIFIED;
+			break;
+		}
+
+		service_status = acc_service_activate(handle);
+		if (service_status == ACC_SERVICE_STATUS_OK) {
+			service_status = acc_service_deactivate(handle);
+		}
+
+		acc_service_destroy(&handle);
+
+		if (scoped) {
+			acc_driver_os_linux_arena_scope_end();
+		}
+
+		if (service_status != ACC_SERVICE_STATUS_OK) {
+			printf("Service cycle %u => (%u) %s\n", (unsigned int)cycle, (unsigned int)service_status,
+			       acc_service_status_name_get(service_status));
+			break;
+		}
+	}
+
+	uint64_t elapsed_ns = acc_driver_os_linux_time_ns() - start_ns;
+
+	if (cycle > 0) {
+		printf("Service: %u create/activate/deactivate/destroy cycles, %.2f ms per cycle\n", (unsigned int)cycle,
+		       elapsed_ns / 1e6 / cycle);
+	}
+
+	if (arena != NULL) {
+		acc_driver_os_linux_arena_stats_t stats;
+
+		acc_driver_os_linux_arena_get_stats(arena, &stats);
+		printf("Arena: %u of %u bytes used at peak, %u allocations did not fit\n", (unsigned int)stats.peak,
+		       (unsigned int)stats.capacity, (unsigned int)stats.overflows);
+	}
+
+	acc_service_envelope_configuration_destroy(&configuration);
+	acc_rss_deactivate();
+	acc_driver_os_linux_arena_destroy(&arena);
+
+	return service_status == ACC_SERVICE_STATUS_OK;
+}
+
+
+void print_pool_stats(void)
+{
+	acc_driver_os_linux_pool_stats_t stats;
+
+	acc_driver_os_linux_pool_get_stats(&stats);
+
+	printf("size     allocations  frees        blocks\n");
+	for (uint_fast8_t index = 0; index < ACC_DRIVER_OS_LINUX_POOL_CLASS_COUNT; index++) {
+		printf("%-8u %-12u %-12u %-12u\n", (unsigned int)stats.classes[index].block_size, (unsigned int)stats.classes[index].allocations,
+		       (unsigned int)stats.classes[index].frees, (unsigned int)stats.classes[index].blocks);
+	}
+	printf("large    %-12u %-12u\n", (unsigned int)stats.large_allocations, (unsigned int)stats.large_frees);
+	printf("Slab memory: %u bytes\n", (unsigned int)stats.slab_bytes);
+}
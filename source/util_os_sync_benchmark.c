@@ -0,0 +1,248 @@
+// Copyright (c) Acconeer AB, 2018
+// All rights reserved
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "acc_log.h"
+#include "acc_os.h"
+#include "acc_os_linux.h"
+
+
+/**
+ * @brief Contention benchmark of the mutexes available to the drivers
+ *
+ * The benchmark executes as follows:
+ *   - Select the mutex type behind acc_os_mutex_t and register the OS driver
+ *   - For 1 up to the maximum number of threads, let every thread lock a shared mutex, update a
+ *     short critical section and unlock, using a pthread mutex, an acc_os_mutex_t and an
+ *     embedded futex mutex in turn
+ *   - Print the time per lock/unlock pair and verify the shared counter
+ */
+
+
+#define DEFAULT_THREAD_COUNT_MAX	4
+#define DEFAULT_ITERATION_COUNT		1000000
+#define THREAD_COUNT_MAX		16
+
+/**
+ * @brief Number of words updated in the critical section, comparable to a GPIO state update
+ */
+#define CRITICAL_SECTION_WORDS		4
+
+
+typedef enum {
+	MUTEX_TYPE_PTHREAD,
+	MUTEX_TYPE_ACC_OS,
+	MUTEX_TYPE_FUTEX,
+	MUTEX_TYPE_COUNT
+} mutex_type_t;
+
+
+typedef struct {
+	bool futex_mutex;
+	uint_fast8_t thread_count_max;
+	uint32_t iteration_count;
+} input_t;
+
+
+typedef struct {
+	mutex_type_t				type;
+	uint32_t				iteration_count;
+	pthread_mutex_t				pthread_mutex;
+	acc_os_mutex_t				acc_os_mutex;
+	acc_driver_os_linux_futex_mutex_t	futex_mutex;
+	volatile uint32_t			words[CRITICAL_SECTION_WORDS];
+} shared_t;
+
+
+static const char *mutex_type_names[MUTEX_TYPE_COUNT] = {"pthread", "acc_os", "futex"};
+
+
+static bool parse_options(int argc, char *argv[], input_t *input);
+static void contention_worker(void *param);
+static bool run_contention_benchmark(shared_t *shared, mutex_type_t type, uint_fast8_t thread_count);
+
+
+int main(int argc, char *argv[])
+{
+	input_t input = {false, DEFAULT_THREAD_COUNT_MAX, DEFAULT_ITERATION_COUNT};
+
+	acc_log_set_level(ACC_LOG_LEVEL_ERROR, NULL);
+
+	if (!parse_options(argc, argv, &input)) {
+		return EXIT_FAILURE;
+	}
+
+	acc_driver_os_linux_set_futex_mutex(input.futex_mutex);
+	acc_driver_os_linux_register();
+	acc_os_init();
+
+	static shared_t shared;
+
+	shared.iteration_count = input.iteration_count;
+	pthread_mutex_init(&shared.pthread_mutex, NULL);
+	acc_driver_os_linux_futex_mutex_init(&shared.futex_mutex);
+	shared.acc_os_mutex = acc_os_mutex_create();
+	if (shared.acc_os_mutex == NULL) {
+		printf("acc_os_mutex_create() failed\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("acc_os_mutex_t: %s\n", input.futex_mutex ? "futex" : "pthread");
+	printf("threads  mutex      ns per lock/unlock\n");
+
+	bool success = true;
+
+	for (uint_fast8_t thread_count = 1; success && thread_count <= input.thread_count_max; thread_count++) {
+		for (mutex_type_t type = 0; success && type < MUTEX_TYPE_COUNT; type++) {
+			success = run_contention_benchmark(&shared, type, thread_count);
+		}
+	}
+
+	acc_os_mutex_destroy(shared.acc_os_mutex);
+	pthread_mutex_destroy(&shared.pthread_mutex);
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+static void print_usage(void)
+{
+	printf("Usage: util_os_sync_benchmark [OPTION]...\n\n");
+	printf("-h, --help                  this help\n");
+	printf("-f, --futex                 use futex mutexes behind acc_os_mutex_t\n");
+	printf("-j, --threads               run with 1 up to this many threads, default %u, max %u\n",
+	       (unsigned int)DEFAULT_THREAD_COUNT_MAX, (unsigned int)THREAD_COUNT_MAX);
+	printf("-n, --iterations            lock/unlock pairs per thread, default %u\n", (unsigned int)DEFAULT_ITERATION_COUNT);
+}
+
+
+bool parse_options(int argc, char *argv[], input_t *input)
+{
+	static struct option long_options[] =
+	{
+		{"futex",           no_argument,        0,      'f'},
+		{"threads",         required_argument,  0,      'j'},
+		{"iterations",      required_argument,  0,      'n'},
+		{"help",            no_argument,        0,      'h'},
+		{NULL,              0,                  NULL,   0}
+	};
+
+	int16_t character_code;
+	int32_t option_index = 0;
+
+	while ((character_code = getopt_long(argc, argv, "fj:n:h?", long_options, &option_index)) != -1) {
+		switch (character_code) {
+			case 'f':
+			{
+				input->futex_mutex = true;
+				break;
+			}
+			case 'j':
+			{
+				input->thread_count_max = atoi(optarg);
+				if ((input->thread_count_max == 0) || (input->thread_count_max > THREAD_COUNT_MAX)) {
+					printf("Invalid number of threads.\n");
+					print_usage();
+					return false;
+				}
+				break;
+			}
+			case 'n':
+			{
+				input->iteration_count = strtoul(optarg, NULL, 10);
+				break;
+			}
+			case 'h':
+			case '?':
+			{
+				print_usage();
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+void contention_worker(void *param)
+{
+	shared_t *shared = param;
+
+	for (uint32_t index = 0; index < shared->iteration_count; index++) {
+		switch (shared->type) {
+			case MUTEX_TYPE_PTHREAD:
+				pthread_mutex_lock(&shared->pthread_mutex);
+				break;
+			case MUTEX_TYPE_ACC_OS:
+				acc_os_mutex_lock(shared->acc_os_mutex);
+				break;
+			default:
+				acc_driver_os_linux_futex_mutex_lock(&shared->futex_mutex);
+				break;
+		}
+
+		for (uint_fast8_t word = 0; word < CRITICAL_SECTION_WORDS; word++) {
+			shared->words[word]++;
+		}
+
+		switch (shared->type) {
+			case MUTEX_TYPE_PTHREAD:
+				pthread_mutex_unlock(&shared->pthread_mutex);
+				break;
+			case MUTEX_TYPE_ACC_OS:
+				acc_os_mutex_unlock(shared->acc_os_mutex);
+				break;
+			default:
+				acc_driver_os_linux_futex_mutex_unlock(&shared->futex_mutex);
+				break;
+		}
+	}
+}
+
+
+bool run_contention_benchmark(shared_t *shared, mutex_type_t type, uint_fast8_t thread_count)
+{
+	acc_os_thread_handle_t threads[THREAD_COUNT_MAX];
+
+	shared->type = type;
+	for (uint_fast8_t word = 0; word < CRITICAL_SECTION_WORDS; word++) {
+		shared->words[word] = 0;
+	}
+
+	uint64_t start_ns = acc_driver_os_linux_time_ns();
+
+	for (uint_fast8_t index = 0; index < thread_count; index++) {
+		threads[index] = acc_os_thread_create(contention_worker, shared);
+		if (threads[index] == NULL) {
+			printf("acc_os_thread_create() failed\n");
+			return false;
+		}
+	}
+
+	for (uint_fast8_t index = 0; index < thread_count; index++) {
+		acc_os_thread_cleanup(threads[index]);
+	}
+
+	uint64_t	elapsed_ns = acc_driver_os_linux_time_ns() - start_ns;
+	uint32_t	expected = shared->iteration_count * thread_count;
+
+	printf("%-8u %-10s %.1f\n", (unsigned int)thread_count, mutex_type_names[type], (double)elapsed_ns / expected);
+
+	for (uint_fast8_t word = 0; word < CRITICAL_SECTION_WORDS; word++) {
+		if (shared->words[word] != expected) {
+			printf("Lost updates with %s mutex, %u of %u\n", mutex_type_names[type], (unsigned int)shared->words[word],
+			       (unsigned int)expected);
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -11,7 +11,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "acc_board.h"
+#include "acc_board_calibration_cache.h"
+#include "acc_board_eeprom.h"
+#include "acc_board_temperature.h"
+#include "acc_driver_hal.h"
+#include "acc_driver_hal_record.h"
+#include "acc_driver_i2c_linux.h"
 #include "acc_log.h"
+#include "acc_os_linux.h"
 #include "acc_rss.h"
 #include "acc_service.h"
 #include "acc_service_power_bins.h"
@@ -27,10 +35,22 @@
 #define DEFAULT_WAIT_FOR_INTERRUPT	true
 #define DEFAULT_RANGE_START_M		0.07f
 #define DEFAULT_RANGE_END_M		0.5f
+#define TEMPERATURE_PERIOD_MS		1000
+#define INTERRUPT_TIMEOUT_MS_MIN	1000
 
 
 volatile sig_atomic_t interrupted = 0;
 
+/**
+ * @brief Paces the sweeps when a sweep rate is requested, NULL otherwise
+ */
+static acc_driver_os_linux_timer_t sweep_timer = NULL;
+
+/**
+ * @brief True if faulty sensors are recovered, false when a recording is replayed
+ */
+static bool sensor_recovery = false;
+
 
 typedef enum {
 	INVALID_SERVICE = 0,
@@ -47,6 +67,17 @@ typedef struct {
 	float start_m;
 	float end_m;
 	char *file_path;
+	char *calibration_cache_path;
+	bool transfer_timing;
+	char *record_path;
+	char *replay_path;
+	acc_driver_hal_replay_speed_t replay_speed;
+	uint_fast8_t temperature_drift;
+	bool memory_report;
+	bool stack_report;
+	float sweep_rate_hz;
+	uint32_t cpu_mask;
+	int_fast8_t priority;
 } input_t;
 
 
@@ -57,6 +88,13 @@ static acc_service_configuration_t set_up_envelope(input_t *input);
 static acc_service_status_t execute_envelope(acc_service_configuration_t envelope_configuration, char *file_path, bool wait_for_interrupt, uint16_t sweep_count);
 static acc_service_configuration_t set_up_iq(input_t *input);
 static acc_service_status_t execute_iq(acc_service_configuration_t iq_configuration, char *file_path, bool wait_for_interrupt, uint16_t sweep_count);
+static void print_transfer_timing(void);
+static acc_service_status_t activate_service(acc_service_handle_t handle, acc_service_configuration_t configuration, bool use_calibration_cache);
+static acc_service_status_t recalibrate_if_needed(acc_service_handle_t handle, acc_service_configuration_t configuration);
+static acc_service_status_t recover_if_faulty(acc_service_handle_t handle, acc_service_configuration_t configuration);
+static void report_sensor_fault(acc_service_configuration_t configuration);
+static bool restore_calibration(acc_service_configuration_t configuration);
+static void store_calibration(acc_service_configuration_t configuration, bool calibration_restored);
 
 
 void interrupt_handler(int signum)
@@ -69,13 +107,18 @@ void interrupt_handler(int signum)
 
 int main(int argc, char *argv[])
 {
-	input_t input = {INVALID_SERVICE, DEFAULT_SWEEP_COUNT, DEFAULT_WAIT_FOR_INTERRUPT, DEFAULT_RANGE_START_M, DEFAULT_RANGE_END_M, NULL};
+	input_t input = {INVALID_SERVICE, DEFAULT_SWEEP_COUNT, DEFAULT_WAIT_FOR_INTERRUPT, DEFAULT_RANGE_START_M, DEFAULT_RANGE_END_M, NULL, NULL, false, NULL, NULL, ACC_DRIVER_HAL_REPLAY_FULL_SPEED,
+	                 ACC_BOARD_TEMPERATURE_DRIFT_THRESHOLD, false, false, 0.0f, 0, 0};
 
 	signal(SIGINT, interrupt_handler);
 
 	acc_log_set_level(ACC_LOG_LEVEL_FATAL, NULL);
 
-	if (!acc_rss_activate()) {
+	// Heap accounting is cheap enough to always have, the report is printed on request
+	acc_driver_os_linux_set_mem_accounting(true);
+
+	// Registers the OS driver, the sensors are not touched until the HAL is initialized
+	if (acc_board_init() != ACC_STATUS_SUCCESS) {
 		return EXIT_FAILURE;
 	}
 
@@ -86,6 +129,72 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	// The sensor interrupt and RSS threads are created when the service is activated
+	acc_driver_os_linux_thread_attributes_t thread_attributes = ACC_DRIVER_OS_LINUX_THREAD_ATTRIBUTES_DEFAULT;
+
+	thread_attributes.name			= "acc_rss";
+	thread_attributes.cpu_mask		= input.cpu_mask;
+	thread_attributes.priority		= input.priority;
+	thread_attributes.stack_tracking	= input.stack_report;
+	acc_driver_os_linux_set_thread_attributes(&thread_attributes);
+
+	acc_hal_t hal;
+
+	if (input.replay_path != NULL) {
+		if (!acc_driver_hal_replay_open(input.replay_path, input.replay_speed, &hal)) {
+			return EXIT_FAILURE;
+		}
+	} else {
+		if (!acc_driver_hal_init()) {
+			return EXIT_FAILURE;
+		}
+
+		hal = acc_driver_hal_get_implementation();
+		sensor_recovery = true;
+
+		// Read the reference frequency from the board EEPROM while the sensor is set up
+		acc_board_eeprom_prefetch();
+
+		if ((input.record_path != NULL) && !acc_driver_hal_record_start(&hal, input.record_path)) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!acc_rss_activate_with_hal(&hal)) {
+		return EXIT_FAILURE;
+	}
+
+	acc_driver_hal_set_transfer_timing(input.transfer_timing);
+
+	// A replayed recording has its calibration decisions recorded already
+	if ((input.replay_path == NULL) && (input.temperature_drift > 0)) {
+		if (acc_board_temperature_monitor_start(TEMPERATURE_PERIOD_MS, input.temperature_drift) != ACC_STATUS_SUCCESS) {
+			printf("Board temperature not available, recalibration on temperature drift disabled\n");
+		}
+	}
+
+	if (input.sweep_rate_hz > 0.0f) {
+		sweep_timer = acc_driver_os_linux_timer_create((uint32_t)(1000000.0f / input.sweep_rate_hz + 0.5f));
+		if (sweep_timer == NULL) {
+			return EXIT_FAILURE;
+		}
+
+		// The interrupt stays active while the next sweep waits for the timer, so allow two sweep periods
+		float interrupt_timeout_ms = 2000.0f / input.sweep_rate_hz;
+
+		if (interrupt_timeout_ms < (float)INTERRUPT_TIMEOUT_MS_MIN) {
+			interrupt_timeout_ms = INTERRUPT_TIMEOUT_MS_MIN;
+		}
+
+		acc_driver_hal_set_interrupt_timeout((interrupt_timeout_ms < (float)UINT32_MAX) ? (uint32_t)interrupt_timeout_ms : UINT32_MAX);
+	}
+
+	if (input.calibration_cache_path != NULL) {
+		if (acc_board_calibration_cache_open(input.calibration_cache_path) != ACC_STATUS_SUCCESS) {
+			printf("Calibration cache %s not available, calibrating on every activation\n", input.calibration_cache_path);
+		}
+	}
+
 	acc_service_status_t service_status;
 
 	switch (input.service_type) {
@@ -173,8 +282,28 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (input.transfer_timing) {
+		print_transfer_timing();
+	}
+
+	if (input.memory_report) {
+		// Printed on stderr to keep the sweep data on stdout intact
+		acc_driver_os_linux_mem_print_report(stderr);
+	}
+
+	if (input.stack_report) {
+		acc_driver_os_linux_print_stack_report(stderr);
+	}
+
+	acc_driver_os_linux_timer_destroy(&sweep_timer);
+	acc_board_temperature_monitor_stop();
+	acc_driver_i2c_linux_stop();
+	acc_board_calibration_cache_close();
 	acc_rss_deactivate();
 
+	acc_driver_hal_record_stop();
+	acc_driver_hal_replay_close();
+
 	return EXIT_SUCCESS;
 }
 
@@ -191,6 +320,18 @@ static void print_usage()
 	printf("-b, --range-start           retrieve envelope starting at this distance [m], default %"PRIfloat"\n", ACC_LOG_FLOAT_TO_INTEGER(DEFAULT_RANGE_START_M));
 	printf("-e, --range-end             retrieve envelope ending at this distance [m], default %"PRIfloat"\n", ACC_LOG_FLOAT_TO_INTEGER(DEFAULT_RANGE_END_M));
 	printf("-o, --out                   path to out file, default stdout\n");
+	printf("-k, --calibration-cache     path to sensor calibration cache file, default none\n");
+	printf("-d, --temperature-drift     recalibrate when the board temperature drifts this much [C], 0 to disable, default %u\n",
+	       (unsigned int)ACC_BOARD_TEMPERATURE_DRIFT_THRESHOLD);
+	printf("-f, --sweep-rate            log sweeps at this fixed rate [Hz], default as fast as the sensor delivers them\n");
+	printf("-a, --cpu-mask              run the radar threads on these CPUs, bit n for CPU n, default all\n");
+	printf("-P, --priority              run the radar threads with this SCHED_FIFO priority 1-99, default normal scheduling\n");
+	printf("-r, --record                path to file to record all sensor accesses to, default none\n");
+	printf("-p, --replay                path to recorded sensor accesses to replay instead of using the sensors\n");
+	printf("-R, --real-time             replay with the recorded timing instead of at full speed\n");
+	printf("-T, --transfer-timing       print the time spent in each phase of the sensor transfers on exit\n");
+	printf("-M, --memory-report         print the heap usage per call site on exit\n");
+	printf("-S, --stack-report          print the stack high-water mark of the radar threads on exit\n");
 	printf("-v, --verbose               set debug level to verbose\n");
 }
 
@@ -204,6 +345,17 @@ bool parse_options(int argc, char *argv[], input_t *input)
 		{"range-start",     required_argument,  0,      'b'},
 		{"range-end",       required_argument,  0,      'e'},
 		{"out",             required_argument,  0,      'o'},
+		{"calibration-cache", required_argument, 0,     'k'},
+		{"temperature-drift", required_argument, 0,     'd'},
+		{"transfer-timing", no_argument,        0,      'T'},
+		{"memory-report",   no_argument,        0,      'M'},
+		{"stack-report",    no_argument,        0,      'S'},
+		{"sweep-rate",      required_argument,  0,      'f'},
+		{"cpu-mask",        required_argument,  0,      'a'},
+		{"priority",        required_argument,  0,      'P'},
+		{"record",          required_argument,  0,      'r'},
+		{"replay",          required_argument,  0,      'p'},
+		{"real-time",       no_argument,        0,      'R'},
 		{"verbose",         no_argument,        0,      'v'},
 		{"help",            no_argument,        0,      'h'},
 		{NULL,              0,                  NULL,   0}
@@ -212,7 +364,7 @@ bool parse_options(int argc, char *argv[], input_t *input)
 	int16_t character_code;
 	int32_t option_index = 0;
 
-	while ((character_code = getopt_long(argc, argv, "t:c:b:e:o:vh?", long_options, &option_index)) != -1) {
+	while ((character_code = getopt_long(argc, argv, "t:c:b:e:o:k:d:TMSf:a:P:r:p:Rvh?", long_options, &option_index)) != -1) {
 		switch (character_code) {
 			case 't':
 			{
@@ -267,6 +419,81 @@ bool parse_options(int argc, char *argv[], input_t *input)
 				snprintf(input->file_path, strlen(optarg) + 1, "%s", optarg);
 				break;
 			}
+			case 'k':
+			{
+				input->calibration_cache_path = optarg;
+				break;
+			}
+			case 'd':
+			{
+				int temperature_drift = atoi(optarg);
+
+				if ((temperature_drift < 0) || (temperature_drift > 100)) {
+					printf("Invalid temperature drift.\n");
+					print_usage();
+					return ACC_STATUS_FAILURE;
+				}
+				input->temperature_drift = temperature_drift;
+				break;
+			}
+			case 'T':
+			{
+				input->transfer_timing = true;
+				break;
+			}
+			case 'M':
+			{
+				input->memory_report = true;
+				break;
+			}
+			case 'S':
+			{
+				input->stack_report = true;
+				break;
+			}
+			case 'f':
+			{
+				input->sweep_rate_hz = strtof(optarg, NULL);
+				// The timer period must fit in 32 bits of microseconds
+				if ((input->sweep_rate_hz != 0.0f) && !(input->sweep_rate_hz >= 0.001f)) {
+					printf("Invalid sweep rate.\n");
+					print_usage();
+					return ACC_STATUS_FAILURE;
+				}
+				break;
+			}
+			case 'a':
+			{
+				input->cpu_mask = strtoul(optarg, NULL, 0);
+				break;
+			}
+			case 'P':
+			{
+				int priority = atoi(optarg);
+
+				if ((priority < 0) || (priority > 99)) {
+					printf("Invalid priority.\n");
+					print_usage();
+					return ACC_STATUS_FAILURE;
+				}
+				input->priority = priority;
+				break;
+			}
+			case 'r':
+			{
+				input->record_path = optarg;
+				break;
+			}
+			case 'p':
+			{
+				input->replay_path = optarg;
+				break;
+			}
+			case 'R':
+			{
+				input->replay_speed = ACC_DRIVER_HAL_REPLAY_REAL_TIME;
+				break;
+			}
 			case 'v':
 			{
 				acc_log_set_level(ACC_LOG_LEVEL_VERBOSE, NULL);
@@ -311,6 +538,11 @@ acc_service_configuration_t set_up_power_bin(input_t *input)
 
 	acc_sweep_configuration_requested_range_set(sweep_configuration, input->start_m, length_m);
 
+	// The sensor sweeps when the sweep is requested, so that the sweep timer sets the rate
+	if (input->sweep_rate_hz > 0.0f) {
+		acc_sweep_configuration_repetition_mode_max_frequency_set(sweep_configuration);
+	}
+
 	return power_bin_configuration;
 }
 
@@ -330,7 +562,7 @@ acc_service_status_t execute_power_bin(acc_service_configuration_t power_bin_con
 	float power_bins_data[power_bins_metadata.actual_bin_count];
 
 	acc_service_power_bins_result_info_t result_info;
-	acc_service_status_t service_status = acc_service_activate(handle);
+	acc_service_status_t service_status = activate_service(handle, power_bin_configuration, true);
 
 	if (service_status == ACC_SERVICE_STATUS_OK) {
 		FILE *file = stdout;
@@ -347,6 +579,20 @@ acc_service_status_t execute_power_bin(acc_service_configuration_t power_bin_con
 		uint16_t sweeps = 0;
 
 		while ((wait_for_interrupt && interrupted == 0) || sweeps < sweep_count) {
+			service_status = recover_if_faulty(handle, power_bin_configuration);
+
+			if (service_status == ACC_SERVICE_STATUS_OK) {
+				service_status = recalibrate_if_needed(handle, power_bin_configuration);
+			}
+
+			if (service_status != ACC_SERVICE_STATUS_OK) {
+				break;
+			}
+
+			if (sweep_timer != NULL) {
+				acc_driver_os_linux_timer_wait(sweep_timer);
+			}
+
 			service_status = acc_service_power_bins_get_next(handle, power_bins_data, power_bins_metadata.actual_bin_count, &result_info);
 
 			if (service_status == ACC_SERVICE_STATUS_OK) {
@@ -357,6 +603,7 @@ acc_service_status_t execute_power_bin(acc_service_configuration_t power_bin_con
 			}
 			else {
 				printf("Power bin data not properly retrieved\n");
+				report_sensor_fault(power_bin_configuration);
 			}
 
 			if (!wait_for_interrupt) {
@@ -403,6 +650,11 @@ acc_service_configuration_t set_up_envelope(input_t *input)
 
 	acc_sweep_configuration_requested_range_set(sweep_configuration, input->start_m, length_m);
 
+	// The sensor sweeps when the sweep is requested, so that the sweep timer sets the rate
+	if (input->sweep_rate_hz > 0.0f) {
+		acc_sweep_configuration_repetition_mode_max_frequency_set(sweep_configuration);
+	}
+
 	return envelope_configuration;
 }
 
@@ -422,7 +674,7 @@ acc_service_status_t execute_envelope(acc_service_configuration_t envelope_confi
 	uint16_t envelope_data[envelope_metadata.data_length];
 
 	acc_service_envelope_result_info_t result_info;
-	acc_service_status_t service_status = acc_service_activate(handle);
+	acc_service_status_t service_status = activate_service(handle, envelope_configuration, true);
 
 	if (service_status == ACC_SERVICE_STATUS_OK) {
 		FILE * file = stdout;
@@ -439,6 +691,20 @@ acc_service_status_t execute_envelope(acc_service_configuration_t envelope_confi
 		uint16_t sweeps = 0;
 
 		while ((wait_for_interrupt && interrupted == 0) || sweeps < sweep_count) {
+			service_status = recover_if_faulty(handle, envelope_configuration);
+
+			if (service_status == ACC_SERVICE_STATUS_OK) {
+				service_status = recalibrate_if_needed(handle, envelope_configuration);
+			}
+
+			if (service_status != ACC_SERVICE_STATUS_OK) {
+				break;
+			}
+
+			if (sweep_timer != NULL) {
+				acc_driver_os_linux_timer_wait(sweep_timer);
+			}
+
 			service_status = acc_service_envelope_get_next(handle, envelope_data, envelope_metadata.data_length, &result_info);
 
 			if (service_status == ACC_SERVICE_STATUS_OK) {
@@ -449,6 +715,7 @@ acc_service_status_t execute_envelope(acc_service_configuration_t envelope_confi
 			}
 			else {
 				printf("Envelope data not properly retrieved\n");
+				report_sensor_fault(envelope_configuration);
 			}
 
 			if (!wait_for_interrupt) {
@@ -495,6 +762,11 @@ acc_service_configuration_t set_up_iq(input_t *input)
 
 	acc_sweep_configuration_requested_range_set(sweep_configuration, input->start_m, length_m);
 
+	// The sensor sweeps when the sweep is requested, so that the sweep timer sets the rate
+	if (input->sweep_rate_hz > 0.0f) {
+		acc_sweep_configuration_repetition_mode_max_frequency_set(sweep_configuration);
+	}
+
 	return iq_configuration;
 }
 
@@ -514,7 +786,7 @@ acc_service_status_t execute_iq(acc_service_configuration_t iq_configuration, ch
 	float complex iq_data[iq_metadata.data_length];
 	acc_service_iq_result_info_t result_info;
 
-	acc_service_status_t service_status = acc_service_activate(handle);
+	acc_service_status_t service_status = activate_service(handle, iq_configuration, true);
 
 	if (service_status == ACC_SERVICE_STATUS_OK) {
 		FILE * file = stdout;
@@ -531,6 +803,20 @@ acc_service_status_t execute_iq(acc_service_configuration_t iq_configuration, ch
 		uint16_t sweeps = 0;
 
 		while ((wait_for_interrupt && interrupted == 0) || sweeps < sweep_count) {
+			service_status = recover_if_faulty(handle, iq_configuration);
+
+			if (service_status == ACC_SERVICE_STATUS_OK) {
+				service_status = recalibrate_if_needed(handle, iq_configuration);
+			}
+
+			if (service_status != ACC_SERVICE_STATUS_OK) {
+				break;
+			}
+
+			if (sweep_timer != NULL) {
+				acc_driver_os_linux_timer_wait(sweep_timer);
+			}
+
 			service_status = acc_service_iq_get_next(handle, iq_data, iq_metadata.data_length, &result_info);
 
 			if (service_status == ACC_SERVICE_STATUS_OK) {
@@ -541,6 +827,7 @@ acc_service_status_t execute_iq(acc_service_configuration_t iq_configuration, ch
 			}
 			else {
 				printf("IQ data not properly retrieved\n");
+				report_sensor_fault(iq_configuration);
 			}
 
 			if (!wait_for_interrupt) {
@@ -565,3 +852,141 @@ acc_service_status_t execute_iq(acc_service_configuration_t iq_configuration, ch
 
 	return service_status;
 }
+
+
+void print_transfer_timing(void)
+{
+	static const char *phase_names[ACC_BOARD_TRANSFER_PHASE_COUNT] = {"lock", "chip select", "spi", "deselect"};
+
+	// Printed on stderr to keep the sweep data on stdout intact
+	fprintf(stderr, "sensor phase          count     mean [us]  min [us]   max [us]   p99 [us]\n");
+
+	for (acc_sensor_id_t sensor = 1; sensor <= acc_board_get_sensor_count(); sensor++) {
+		for (uint_fast8_t phase = 0; phase < ACC_BOARD_TRANSFER_PHASE_COUNT; phase++) {
+			acc_driver_hal_transfer_timing_t timing;
+
+			if (!acc_driver_hal_get_transfer_timing(sensor, phase, &timing) || (timing.count == 0)) {
+				continue;
+			}
+
+			fprintf(stderr, "%-6u %-13s %-9u %-10.1f %-10.1f %-10.1f %-10.1f\n", (unsigned int)sensor, phase_names[phase],
+			        (unsigned int)timing.count, (double)timing.sum_ns / timing.count / 1000, timing.min_ns / 1000.0,
+			        timing.max_ns / 1000.0, timing.p99_ns / 1000.0);
+		}
+	}
+}
+
+
+acc_service_status_t activate_service(acc_service_handle_t handle, acc_service_configuration_t configuration, bool use_calibration_cache)
+{
+	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(configuration);
+	acc_sensor_id_t sensor = acc_sweep_configuration_sensor_get(sweep_configuration);
+
+	bool calibration_restored = use_calibration_cache && restore_calibration(configuration);
+
+	// Configuration and calibration consist of many small transfers to the same sensor
+	acc_driver_hal_set_transfer_batching(sensor, true);
+	acc_service_status_t service_status = acc_service_activate(handle);
+	acc_driver_hal_set_transfer_batching(sensor, false);
+
+	if (service_status == ACC_SERVICE_STATUS_OK) {
+		store_calibration(configuration, calibration_restored);
+		acc_board_temperature_set_calibrated(sensor, acc_board_temperature_get());
+	}
+
+	return service_status;
+}
+
+
+acc_service_status_t recalibrate_if_needed(acc_service_handle_t handle, acc_service_configuration_t configuration)
+{
+	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(configuration);
+	acc_sensor_id_t sensor = acc_sweep_configuration_sensor_get(sweep_configuration);
+
+	if (!acc_board_temperature_recalibration_needed(sensor)) {
+		return ACC_SERVICE_STATUS_OK;
+	}
+
+	acc_service_status_t service_status = acc_service_deactivate(handle);
+
+	if (service_status != ACC_SERVICE_STATUS_OK) {
+		return service_status;
+	}
+
+	if (!acc_rss_calibration_reset(sensor)) {
+		printf("acc_rss_calibration_reset() failed\n");
+	}
+
+	// The cache may hold a calibration within its tolerance of the current temperature, but the
+	// drift has just invalidated it, so the sensor is calibrated and the cache updated instead
+	service_status = activate_service(handle, configuration, false);
+
+	if (service_status != ACC_SERVICE_STATUS_OK) {
+		printf("acc_service_activate() %u => %s\n", (unsigned int)service_status, acc_service_status_name_get(service_status));
+	}
+
+	return service_status;
+}
+
+
+acc_service_status_t recover_if_faulty(acc_service_handle_t handle, acc_service_configuration_t configuration)
+{
+	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(configuration);
+	acc_sensor_id_t sensor = acc_sweep_configuration_sensor_get(sweep_configuration);
+
+	if (!sensor_recovery || !acc_driver_hal_sensor_has_fault(sensor)) {
+		return ACC_SERVICE_STATUS_OK;
+	}
+
+	printf("Sensor %u has a fault, recovering\n", (unsigned int)sensor);
+
+	// The faulty sensor may not respond to the deactivation, it is power cycled regardless
+	acc_service_deactivate(handle);
+
+	if (!acc_driver_hal_recover_sensor(sensor)) {
+		printf("Sensor %u could not be recovered\n", (unsigned int)sensor);
+		return ACC_SERVICE_STATUS_FAILURE_UNSPECIFIED;
+	}
+
+	acc_service_status_t service_status = activate_service(handle, configuration, true);
+
+	if (service_status != ACC_SERVICE_STATUS_OK) {
+		printf("acc_service_activate() %u => %s\n", (unsigned int)service_status, acc_service_status_name_get(service_status));
+	}
+
+	return service_status;
+}
+
+
+void report_sensor_fault(acc_service_configuration_t configuration)
+{
+	if (!sensor_recovery) {
+		return;
+	}
+
+	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(configuration);
+
+	acc_driver_hal_report_sensor_fault(acc_sweep_configuration_sensor_get(sweep_configuration));
+}
+
+
+bool restore_calibration(acc_service_configuration_t configuration)
+{
+	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(configuration);
+	acc_sensor_id_t sensor = acc_sweep_configuration_sensor_get(sweep_configuration);
+
+	return acc_board_calibration_cache_restore(sensor, acc_board_temperature_get());
+}
+
+
+void store_calibration(acc_service_configuration_t configuration, bool calibration_restored)
+{
+	if (calibration_restored) {
+		return;
+	}
+
+	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(configuration);
+	acc_sensor_id_t sensor = acc_sweep_configuration_sensor_get(sweep_configuration);
+
+	acc_board_calibration_cache_store(sensor, acc_board_temperature_get());
+}